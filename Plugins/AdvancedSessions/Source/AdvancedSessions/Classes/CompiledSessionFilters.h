@@ -0,0 +1,34 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "BlueprintDataDefinitions.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(AdvancedSessionFilterLog, Log, All);
+
+// Client side session filters, compiled once into typed tests and then run over any number of results
+// Same rules as UFindSessionsCallbackProxyAdvanced::CompareVariants: a setting the session does not have passes,
+// a setting of another type or a comparison its type does not support fails
+class ADVANCEDSESSIONS_API FCompiledSessionFilters
+{
+public:
+	explicit FCompiledSessionFilters(const TArray<FSessionsSearchSetting>& Filters);
+
+	// Whether a session's settings pass every filter
+	bool Matches(const FOnlineSessionSettings& Settings) const;
+
+	// Appends the results passing every filter to FilteredResults, in order. Large result sets are split across task graph workers
+	void Filter(const TArray<FBlueprintSessionResult>& SessionResults, TArray<FBlueprintSessionResult>& FilteredResults) const;
+
+	// Results from this many on are filtered in parallel
+	static const int32 ParallelThreshold = 2048;
+
+private:
+	typedef TFunction<bool(const FVariantData&)> FSettingTest;
+
+	struct FCompiledFilter
+	{
+		FName Key;
+		FSettingTest Test;
+	};
+
+	TArray<FCompiledFilter> CompiledFilters;
+};
@@ -19,9 +19,14 @@ class UFindSessionsCallbackProxyAdvanced : public UOnlineBlueprintCallProxyBase
 	UPROPERTY(BlueprintAssignable)
 	FBlueprintFindSessionsResultDelegate OnFailure;
 
+	// Called with the results of the first search to finish when searching all servers, while the other search is still running
+	UPROPERTY(BlueprintAssignable)
+	FBlueprintFindSessionsResultDelegate OnPartialResults;
+
 	// Searches for advertised sessions with the default online subsystem and includes an array of filters
+	// When searching all servers the listen and dedicated server searches run at the same time, each given up on after QueryTimeout seconds (0 waits forever)
 	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", AutoCreateRefTerm="Filters"), Category = "Online|AdvancedSessions")
-	static UFindSessionsCallbackProxyAdvanced* FindSessionsAdvanced(UObject* WorldContextObject, class APlayerController* PlayerController, int32 MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting> &Filters, bool bEmptyServersOnly = false, bool bNonEmptyServersOnly = false, bool bSecureServersOnly = false, int MinSlotsAvailable = 0);
+	static UFindSessionsCallbackProxyAdvanced* FindSessionsAdvanced(UObject* WorldContextObject, class APlayerController* PlayerController, int32 MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting> &Filters, bool bEmptyServersOnly = false, bool bNonEmptyServersOnly = false, bool bSecureServersOnly = false, int MinSlotsAvailable = 0, float QueryTimeout = 10.0f);
 
 	static bool CompareVariants(const FVariantData &A, const FVariantData &B, EOnlineComparisonOpRedux Comparator);
 	
@@ -47,16 +52,42 @@ class UFindSessionsCallbackProxyAdvanced : public UOnlineBlueprintCallProxyBase
 	virtual void Activate() override;
 	// End of UOnlineBlueprintCallProxyBase interface
 
-private:
-	// Internal callback when the session search completes, calls out to the public success/failure callbacks
+protected:
+	// One search issued to the session interface
+	struct FSessionQuery
+	{
+		TSharedPtr<FOnlineSessionSearch> Search;
+		FTimerHandle TimeoutHandle;
+		// Results already taken from Search->SearchResults
+		int32 NumCollected = 0;
+		bool bStarted = false;
+		bool bFinished = false;
+	};
+
+	// Internal callback when a session search completes, works out which of our queries finished from their search states
 	void OnCompleted(bool bSuccess);
 
-	bool bRunSecondSearch;
-	bool bIsOnSecondSearch;
+	// Starts a query, returns false if the session interface would not take it while another search is pending
+	bool StartQuery(int32 QueryIndex);
+
+	// Collects a finished query's results, starts any query that had to wait and finishes the proxy once all are done
+	void FinishQuery(int32 QueryIndex, bool bSucceeded);
+
+	void OnQueryTimedOut(int32 QueryIndex);
+
+	// Takes the results a query found since it was last collected into SessionSearchResults, and returns them in OutNewResults
+	virtual void CollectQueryResults(int32 QueryIndex, TArray<FBlueprintSessionResult>& OutNewResults);
+
+	// Clears the completion delegate and broadcasts OnSuccess or OnFailure with everything found
+	virtual void FinishSearch();
+
+	// Listen server search first, then the dedicated server search when searching all servers
+	TArray<FSessionQuery, TInlineAllocator<2>> Queries;
+
+	bool bAnyQuerySucceeded;
 
 	TArray<FBlueprintSessionResult> SessionSearchResults;
 
-private:
 	// The player controller triggering things
 	TWeakObjectPtr<APlayerController> PlayerControllerWeakPtr;
 
@@ -66,10 +97,6 @@ private:
 	// Handle to the registered OnFindSessionsComplete delegate
 	FDelegateHandle DelegateHandle;
 
-	// Object to track search results
-	TSharedPtr<FOnlineSessionSearch> SearchObject;
-	TSharedPtr<FOnlineSessionSearch> SearchObjectDedicated;
-
 	// Whether or not to search LAN
 	bool bUseLAN;
 
@@ -94,6 +121,9 @@ private:
 	// Min slots requires to search
 	int MinSlotsAvailable;
 
+	// Seconds before a query that has not finished is given up on, 0 for no timeout
+	float QueryTimeout;
+
 	// The world context object in which this call is taking place
 	UObject* WorldContextObject;
 };
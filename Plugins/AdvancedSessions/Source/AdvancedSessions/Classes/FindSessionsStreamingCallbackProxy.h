@@ -0,0 +1,56 @@
+// Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
+#pragma once
+#include "CoreMinimal.h"
+#include "FindSessionsCallbackProxyAdvanced.h"
+#include "FindSessionsStreamingCallbackProxy.generated.h"
+
+// Session search that hands results out in pages while the search is still running, instead of all at once at the end
+// Results are read from the searches every frame, so subsystems that fill their results as servers answer (LAN) stream server by server,
+// the others stream once per finished search. Sessions found by both the listen and dedicated server searches are only reported once.
+UCLASS(MinimalAPI)
+class UFindSessionsStreamingCallbackProxy : public UFindSessionsCallbackProxyAdvanced
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called with each page of new results, at most one page per frame
+	UPROPERTY(BlueprintAssignable)
+	FBlueprintFindSessionsResultDelegate OnResultsPage;
+
+	// Searches like FindSessionsAdvanced but streams results through OnResultsPage, OnSuccess follows the last page with every result
+	// PageSize limits how many results one page holds (0 for no limit), CancelAfterResults stops the search once that many sessions were found (0 for no limit)
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", AutoCreateRefTerm="Filters"), Category = "Online|AdvancedSessions")
+	static UFindSessionsStreamingCallbackProxy* FindSessionsStreaming(UObject* WorldContextObject, class APlayerController* PlayerController, int32 MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting> &Filters, bool bEmptyServersOnly = false, bool bNonEmptyServersOnly = false, bool bSecureServersOnly = false, int MinSlotsAvailable = 0, float QueryTimeout = 10.0f, int32 PageSize = 20, int32 CancelAfterResults = 0);
+
+	// UOnlineBlueprintCallProxyBase interface
+	virtual void Activate() override;
+	// End of UOnlineBlueprintCallProxyBase interface
+
+protected:
+	virtual void CollectQueryResults(int32 QueryIndex, TArray<FBlueprintSessionResult>& OutNewResults) override;
+
+	virtual void FinishSearch() override;
+
+private:
+	// Collects from the running searches and sends one page, then waits for the next frame
+	void PollResults();
+
+	// Stops every running search once CancelAfterResults sessions were found
+	void CancelSearch();
+
+	void SchedulePoll();
+
+	// Found but not sent in a page yet
+	TArray<FBlueprintSessionResult> PendingPageResults;
+
+	// Ids of every session reported, to drop the ones both searches find
+	TSet<FString> SeenSessionIds;
+
+	int32 PageSize;
+
+	int32 CancelAfterResults;
+
+	// All searches are over, OnSuccess or OnFailure follows once the pending results have been sent
+	bool bSearchFinished;
+
+	bool bCancelled;
+};
@@ -0,0 +1,105 @@
+// Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
+#pragma once
+#include "CoreMinimal.h"
+#include "FindSessionsCallbackProxy.h"
+#include "BlueprintDataDefinitions.h"
+#include "PingSessionsCallbackProxy.generated.h"
+
+class FSessionPingProber;
+
+// How sessions are scored for ranking, higher scores first
+USTRUCT(BlueprintType)
+struct FSessionRankWeights
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Score lost per millisecond of ping
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Online|AdvancedSessions|Ping")
+	float PingWeight = 1.0f;
+
+	// Score gained per open public slot
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Online|AdvancedSessions|Ping")
+	float FreeSlotWeight = 10.0f;
+
+	// Numeric session setting added to the score, none if left empty
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Online|AdvancedSessions|Ping")
+	FName CustomSettingKey;
+
+	// Score gained per unit of the custom setting
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Online|AdvancedSessions|Ping")
+	float CustomSettingWeight = 0.0f;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FBlueprintSessionPingedDelegate, int32, ResultIndex, const FBlueprintSessionResult&, Result);
+
+UCLASS(MinimalAPI)
+class UPingSessionsCallbackProxy : public UOnlineBlueprintCallProxyBase
+{
+	GENERATED_UCLASS_BODY()
+
+	// Called as each session answers or times out, with its index in the results passed in and its ping updated
+	UPROPERTY(BlueprintAssignable)
+	FBlueprintSessionPingedDelegate OnPinged;
+
+	// Called once every session was pinged, with the results ranked
+	UPROPERTY(BlueprintAssignable)
+	FBlueprintFindSessionsResultDelegate OnSuccess;
+
+	// Called with the results ranked by the pings the online subsystem reported, when no probe could be sent
+	UPROPERTY(BlueprintAssignable)
+	FBlueprintFindSessionsResultDelegate OnFailure;
+
+	// Pings found sessions over UDP and ranks them. Servers answer on the port in their PINGPORT setting, or their game port plus ProbePortOffset
+	// At most MaxInFlight probes are out at once, each given up on after Timeout seconds. A session that does not answer keeps the ping it was found with
+	UFUNCTION(BlueprintCallable, meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject"), Category = "Online|AdvancedSessions|Ping")
+	static UPingSessionsCallbackProxy* PingSessions(UObject* WorldContextObject, const TArray<FBlueprintSessionResult>& SessionResults, FSessionRankWeights Weights, int32 MaxInFlight = 8, float Timeout = 1.0f, int32 ProbePortOffset = 10, int MinSlotsAvailable = 0);
+
+	// Sorts sessions by score, best first, dropping any with fewer than MinSlotsAvailable open public slots
+	UFUNCTION(BlueprintCallable, Category = "Online|AdvancedSessions|Ping")
+	static void RankSessionResults(const TArray<FBlueprintSessionResult>& SessionResults, FSessionRankWeights Weights, int MinSlotsAvailable, TArray<FBlueprintSessionResult>& RankedResults);
+
+	// RankSessionResults with the score worked out by the caller
+	static void RankSessionResultsBy(const TArray<FBlueprintSessionResult>& SessionResults, TFunctionRef<float(const FBlueprintSessionResult&)> Score, int MinSlotsAvailable, TArray<FBlueprintSessionResult>& RankedResults);
+
+	// Score of one session with these weights
+	UFUNCTION(BlueprintPure, Category = "Online|AdvancedSessions|Ping")
+	static float GetSessionScore(const FBlueprintSessionResult& Result, FSessionRankWeights Weights);
+
+	// Session setting servers advertise their ping responder port in
+	static const FName PingPortSettingKey;
+
+	// UOnlineBlueprintCallProxyBase interface
+	virtual void Activate() override;
+	// End of UOnlineBlueprintCallProxyBase interface
+
+	virtual void BeginDestroy() override;
+
+private:
+	void OnTargetPinged(int32 TargetIndex, int32 PingInMs);
+
+	void OnAllPinged();
+
+	// Ranks the results and broadcasts them
+	void Finish(bool bSucceeded);
+
+	TSharedPtr<FSessionPingProber, ESPMode::ThreadSafe> Prober;
+
+	// Results passed in, pings are written into them as they come back
+	TArray<FBlueprintSessionResult> SessionResults;
+
+	// Index into SessionResults of each probe target
+	TArray<int32> TargetResultIndices;
+
+	FSessionRankWeights Weights;
+
+	int32 MaxInFlight;
+
+	float Timeout;
+
+	int32 ProbePortOffset;
+
+	int MinSlotsAvailable;
+
+	// The world context object in which this call is taking place
+	UObject* WorldContextObject;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Interfaces/IPv4/IPv4Endpoint.h"
+
+class FSocket;
+class FUdpSocketReceiver;
+
+DECLARE_LOG_CATEGORY_EXTERN(AdvancedSessionPingLog, Log, All);
+
+// Measures round trip times to a list of UDP endpoints running a FSessionPingResponder
+// Up to MaxInFlight probes are outstanding at once, each given up on after TimeoutSeconds. Replies are timestamped on the
+// receive thread, so the game thread frame rate does not add to the measured ping. Ticks itself, create with MakeShared
+class ADVANCEDSESSIONS_API FSessionPingProber : public TSharedFromThis<FSessionPingProber, ESPMode::ThreadSafe>
+{
+public:
+	// Target index and its round trip in milliseconds, -1 if it timed out
+	DECLARE_DELEGATE_TwoParams(FOnTargetPinged, int32, int32);
+	DECLARE_DELEGATE(FOnAllPinged);
+
+	FSessionPingProber(const TArray<FIPv4Endpoint>& InTargets, int32 InMaxInFlight, float InTimeoutSeconds);
+	~FSessionPingProber();
+
+	// Opens the socket and starts probing, returns false if the socket could not be opened
+	bool Start();
+
+	// Stops probing, nothing is reported after this
+	void Cancel();
+
+	// Called on the game thread as each target answers or times out
+	FOnTargetPinged OnTargetPinged;
+
+	// Called on the game thread once every target has answered or timed out
+	FOnAllPinged OnAllPinged;
+
+	// First four bytes of every probe and reply
+	static const uint32 ProbeMagic = 0x41535047;
+
+	// Bytes in a probe: magic and target index
+	static const int32 ProbeSize = 8;
+
+private:
+	// Replies handed from the receive thread to the game thread, shared so the receive thread never keeps the prober alive
+	struct FReplyInbox
+	{
+		struct FReply
+		{
+			uint32 TargetIndex;
+			double ReceiveTime;
+			FIPv4Endpoint Sender;
+		};
+
+		TQueue<FReply, EQueueMode::Mpsc> Replies;
+	};
+
+	bool Tick(float DeltaTime);
+
+	void SendProbe(int32 TargetIndex);
+
+	void FinishTarget(int32 TargetIndex, int32 PingInMs);
+
+	void CloseSocket();
+
+	TArray<FIPv4Endpoint> Targets;
+
+	// When each target's probe went out, 0 until it does
+	TArray<double> SendTimes;
+
+	TArray<bool> Finished;
+
+	// Targets with a probe out and no reply yet
+	TArray<int32> InFlight;
+
+	int32 NextTarget;
+
+	int32 NumFinished;
+
+	int32 MaxInFlight;
+
+	float TimeoutSeconds;
+
+	TSharedRef<FReplyInbox, ESPMode::ThreadSafe> Inbox;
+
+	FSocket* Socket;
+
+	FUdpSocketReceiver* Receiver;
+
+	FDelegateHandle TickHandle;
+};
+
+// Echoes ping probes back to their sender on a UDP port, what a server runs so FSessionPingProber can measure it
+// Start one with -SessionPingPort=<port> on the command line or the AdvancedSessions.PingResponder console command.
+// Sessions created while the shared responder runs advertise its port in their PINGPORT setting
+class ADVANCEDSESSIONS_API FSessionPingResponder
+{
+public:
+	explicit FSessionPingResponder(int32 InPort);
+	~FSessionPingResponder();
+
+	bool IsListening() const { return Socket != nullptr; }
+
+	// The process wide responder used by the command line and console command
+	static void StartShared(int32 Port);
+	static void StopShared();
+
+	// Port the shared responder answers on, 0 if it is not running
+	static int32 GetSharedPort();
+
+private:
+	int32 Port;
+
+	FSocket* Socket;
+
+	FUdpSocketReceiver* Receiver;
+};
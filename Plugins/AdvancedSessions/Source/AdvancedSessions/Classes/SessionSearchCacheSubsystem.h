@@ -0,0 +1,152 @@
+#pragma once
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "BlueprintDataDefinitions.h"
+#include "SessionSearchCacheSubsystem.generated.h"
+
+class UFindSessionsCallbackProxyAdvanced;
+class USessionSearchCacheSubsystem;
+
+// What a background refresh changed in one cached search
+USTRUCT(BlueprintType)
+struct FBlueprintSessionCacheDelta
+{
+	GENERATED_USTRUCT_BODY()
+
+	// The search this is for, as returned by FindSessionsCached
+	UPROPERTY(BlueprintReadOnly, Category = "Online|AdvancedSessions|Cache")
+	int32 QueryHandle = 0;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Online|AdvancedSessions|Cache")
+	TArray<FBlueprintSessionResult> Added;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Online|AdvancedSessions|Cache")
+	TArray<FBlueprintSessionResult> Removed;
+
+	// Sessions found again with different open slots or settings, as they are now
+	UPROPERTY(BlueprintReadOnly, Category = "Online|AdvancedSessions|Cache")
+	TArray<FBlueprintSessionResult> Changed;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FBlueprintSessionCacheDeltaDelegate, const FBlueprintSessionCacheDelta&, Delta);
+
+// The parameters of one cached search, two searches share cached results only when all of them match
+struct FSessionSearchCacheKey
+{
+	int32 MaxResults = 0;
+	bool bUseLAN = false;
+	EBPServerPresenceSearchType ServerTypeToSearch = EBPServerPresenceSearchType::AllServers;
+	TArray<FSessionsSearchSetting> Filters;
+	bool bEmptyServersOnly = false;
+	bool bNonEmptyServersOnly = false;
+	bool bSecureServersOnly = false;
+	int MinSlotsAvailable = 0;
+
+	bool operator==(const FSessionSearchCacheKey& Other) const;
+
+	friend uint32 GetTypeHash(const FSessionSearchCacheKey& Key);
+};
+
+// Results of one search, and when they were found
+USTRUCT()
+struct FSessionSearchCacheEntry
+{
+	GENERATED_USTRUCT_BODY()
+
+	// The search these results are for
+	FSessionSearchCacheKey Key;
+
+	UPROPERTY()
+	TArray<FBlueprintSessionResult> Results;
+
+	// Running refresh, null when there is none
+	UPROPERTY()
+	class USessionCacheRefresh* Refresh = nullptr;
+
+	double FetchTime = 0.0;
+
+	double LastUsedTime = 0.0;
+
+	// Rough memory held by Results
+	int64 NumBytes = 0;
+
+	bool bHasResults = false;
+};
+
+// Runs one background search for the cache and hands its results back
+UCLASS(MinimalAPI)
+class USessionCacheRefresh : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	void Start(USessionSearchCacheSubsystem* InCache, int32 InQueryHandle, UFindSessionsCallbackProxyAdvanced* InProxy);
+
+private:
+	UFUNCTION()
+	void OnSucceeded(const TArray<FBlueprintSessionResult>& Results);
+
+	UFUNCTION()
+	void OnFailed(const TArray<FBlueprintSessionResult>& Results);
+
+	UPROPERTY()
+	UFindSessionsCallbackProxyAdvanced* Proxy;
+
+	TWeakObjectPtr<USessionSearchCacheSubsystem> Cache;
+
+	int32 QueryHandle;
+};
+
+// Game instance wide cache of session searches, so reopening the server browser shows the last results at once
+// Searches are keyed by all of their parameters, filters included. Results older than TimeToLive are still returned,
+// marked stale, while a search refreshes them in the background and OnCachedSessionsUpdated reports what it changed
+UCLASS(MinimalAPI, config = Game)
+class USessionSearchCacheSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	USessionSearchCacheSubsystem();
+
+	// Called when a background refresh finishes with the sessions it added, removed and changed
+	UPROPERTY(BlueprintAssignable, Category = "Online|AdvancedSessions|Cache")
+	FBlueprintSessionCacheDeltaDelegate OnCachedSessionsUpdated;
+
+	// Returns the cached results of this search straight away and refreshes them in the background if they are stale or missing
+	// The parameters are those of FindSessionsAdvanced. Returns the handle deltas for this search are reported under
+	UFUNCTION(BlueprintCallable, Category = "Online|AdvancedSessions|Cache", meta = (AutoCreateRefTerm = "Filters"))
+	int32 FindSessionsCached(APlayerController* PlayerController, int32 MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting>& Filters, bool bEmptyServersOnly, bool bNonEmptyServersOnly, bool bSecureServersOnly, int MinSlotsAvailable, TArray<FBlueprintSessionResult>& CachedResults, bool& bIsStale);
+
+	// Drops every cached result. Refreshes already running still finish and report everything they found as added
+	UFUNCTION(BlueprintCallable, Category = "Online|AdvancedSessions|Cache")
+	void InvalidateCache();
+
+	// Seconds before cached results are refreshed
+	UPROPERTY(config, EditAnywhere, Category = "Online|AdvancedSessions|Cache")
+	float TimeToLive;
+
+	// Most memory cached results may take, least recently used searches are dropped first
+	UPROPERTY(config, EditAnywhere, Category = "Online|AdvancedSessions|Cache")
+	int32 MaxCacheKilobytes;
+
+	// Called by USessionCacheRefresh
+	void OnRefreshFinished(int32 QueryHandle, bool bSucceeded, const TArray<FBlueprintSessionResult>& Results);
+
+private:
+	static int64 EstimateBytes(const FBlueprintSessionResult& Result);
+
+	static bool HasSessionChanged(const FBlueprintSessionResult& Old, const FBlueprintSessionResult& New);
+
+	// Drops least recently used searches, then trims KeepHandle's results, until the cache fits MaxCacheKilobytes
+	void EnforceBudget(int32 KeepHandle);
+
+	// Cached searches by query handle
+	UPROPERTY()
+	TMap<int32, FSessionSearchCacheEntry> Entries;
+
+	// Query handle of each cached search
+	TMap<FSessionSearchCacheKey, int32> QueryHandles;
+
+	// Last query handle given out, each search newly cached gets the next one
+	int32 LastQueryHandle;
+};
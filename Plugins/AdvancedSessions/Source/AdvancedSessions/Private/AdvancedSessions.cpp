@@ -1,12 +1,19 @@
 //#include "StandAlonePrivatePCH.h"
 #include "AdvancedSessions.h"
+#include "SessionPingProber.h"
+#include "Misc/CommandLine.h"
 
 void AdvancedSessions::StartupModule()
 {
+	// Servers started with -SessionPingPort=<port> answer the pings of UPingSessionsCallbackProxy
+	int32 PingPort = 0;
+	if (FParse::Value(FCommandLine::Get(), TEXT("SessionPingPort="), PingPort))
+		FSessionPingResponder::StartShared(PingPort);
 }
  
 void AdvancedSessions::ShutdownModule()
 {
+	FSessionPingResponder::StopShared();
 }
  
 IMPLEMENT_MODULE(AdvancedSessions, AdvancedSessions)
\ No newline at end of file
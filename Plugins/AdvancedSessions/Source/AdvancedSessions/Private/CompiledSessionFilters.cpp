@@ -0,0 +1,130 @@
+#include "CompiledSessionFilters.h"
+#include "Async/ParallelFor.h"
+
+DEFINE_LOG_CATEGORY(AdvancedSessionFilterLog);
+
+namespace
+{
+	typedef TFunction<bool(const FVariantData&)> FSettingTest;
+
+	// Builds the test for one filter value, the type and comparison are only switched on here
+	template <typename ValueType>
+	FSettingTest MakeSettingTest(const FVariantData& FilterData, EOnlineComparisonOpRedux Comparator, bool bOrdered)
+	{
+		const EOnlineKeyValuePairDataType::Type Type = FilterData.GetType();
+		ValueType Value;
+		FilterData.GetValue(Value);
+
+		switch (Comparator)
+		{
+		case EOnlineComparisonOpRedux::Equals:
+			return [Type, Value](const FVariantData& Data) { ValueType A; return Data.GetType() == Type && (Data.GetValue(A), A == Value); };
+		case EOnlineComparisonOpRedux::NotEquals:
+			return [Type, Value](const FVariantData& Data) { ValueType A; return Data.GetType() == Type && (Data.GetValue(A), A != Value); };
+		default:
+			break;
+		}
+
+		if (bOrdered)
+		{
+			switch (Comparator)
+			{
+			case EOnlineComparisonOpRedux::GreaterThanEquals:
+				return [Type, Value](const FVariantData& Data) { ValueType A; return Data.GetType() == Type && (Data.GetValue(A), A >= Value); };
+			case EOnlineComparisonOpRedux::LessThanEquals:
+				return [Type, Value](const FVariantData& Data) { ValueType A; return Data.GetType() == Type && (Data.GetValue(A), A <= Value); };
+			case EOnlineComparisonOpRedux::GreaterThan:
+				return [Type, Value](const FVariantData& Data) { ValueType A; return Data.GetType() == Type && (Data.GetValue(A), A > Value); };
+			case EOnlineComparisonOpRedux::LessThan:
+				return [Type, Value](const FVariantData& Data) { ValueType A; return Data.GetType() == Type && (Data.GetValue(A), A < Value); };
+			default:
+				break;
+			}
+		}
+
+		return [](const FVariantData&) { return false; };
+	}
+
+	FSettingTest CompileSettingTest(const FVariantData& FilterData, EOnlineComparisonOpRedux Comparator)
+	{
+		switch (FilterData.GetType())
+		{
+		case EOnlineKeyValuePairDataType::Bool:
+			return MakeSettingTest<bool>(FilterData, Comparator, false);
+		case EOnlineKeyValuePairDataType::Double:
+			return MakeSettingTest<double>(FilterData, Comparator, true);
+		case EOnlineKeyValuePairDataType::Float:
+			return MakeSettingTest<float>(FilterData, Comparator, true);
+		case EOnlineKeyValuePairDataType::Int32:
+			return MakeSettingTest<int32>(FilterData, Comparator, true);
+		case EOnlineKeyValuePairDataType::Int64:
+			return MakeSettingTest<int64>(FilterData, Comparator, true);
+		case EOnlineKeyValuePairDataType::String:
+			return MakeSettingTest<FString>(FilterData, Comparator, false);
+		case EOnlineKeyValuePairDataType::Empty:
+		case EOnlineKeyValuePairDataType::Blob:
+		default:
+			return [](const FVariantData&) { return false; };
+		}
+	}
+}
+
+FCompiledSessionFilters::FCompiledSessionFilters(const TArray<FSessionsSearchSetting>& Filters)
+{
+	CompiledFilters.Reserve(Filters.Num());
+	for (const FSessionsSearchSetting& Filter : Filters)
+	{
+		FCompiledFilter& Compiled = CompiledFilters.AddDefaulted_GetRef();
+		Compiled.Key = Filter.PropertyKeyPair.Key;
+		Compiled.Test = CompileSettingTest(Filter.PropertyKeyPair.Data, Filter.ComparisonOp);
+	}
+}
+
+bool FCompiledSessionFilters::Matches(const FOnlineSessionSettings& Settings) const
+{
+	for (const FCompiledFilter& Filter : CompiledFilters)
+	{
+		const FOnlineSessionSetting* Setting = Settings.Settings.Find(Filter.Key);
+
+		// Couldn't find this key
+		if (!Setting)
+			continue;
+
+		if (!Filter.Test(Setting->Data))
+			return false;
+	}
+	return true;
+}
+
+void FCompiledSessionFilters::Filter(const TArray<FBlueprintSessionResult>& SessionResults, TArray<FBlueprintSessionResult>& FilteredResults) const
+{
+	if (CompiledFilters.Num() == 0)
+	{
+		FilteredResults.Append(SessionResults);
+		return;
+	}
+
+	if (SessionResults.Num() < ParallelThreshold)
+	{
+		for (const FBlueprintSessionResult& Result : SessionResults)
+		{
+			if (Matches(Result.OnlineResult.Session.SessionSettings))
+				FilteredResults.Add(Result);
+		}
+		return;
+	}
+
+	// Workers only mark results, copying them out stays on this thread so the order is kept
+	TArray<uint8> Passed;
+	Passed.SetNumUninitialized(SessionResults.Num());
+	ParallelFor(SessionResults.Num(), [this, &SessionResults, &Passed](int32 Index)
+	{
+		Passed[Index] = Matches(SessionResults[Index].OnlineResult.Session.SessionSettings) ? 1 : 0;
+	});
+
+	for (int32 i = 0; i < SessionResults.Num(); i++)
+	{
+		if (Passed[i])
+			FilteredResults.Add(SessionResults[i]);
+	}
+}
@@ -1,5 +1,7 @@
 // Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
 #include "CreateSessionCallbackProxyAdvanced.h"
+#include "PingSessionsCallbackProxy.h"
+#include "SessionPingProber.h"
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -77,6 +79,11 @@ void UCreateSessionCallbackProxyAdvanced::Activate()
 				ExtraSetting.AdvertisementType = EOnlineDataAdvertisementType::ViaOnlineService;
 				Settings.Settings.Add(ExtraSettings[i].Key, ExtraSetting);
 			}
+
+			// Lets UPingSessionsCallbackProxy find the ping responder without guessing its port
+			const int32 PingPort = FSessionPingResponder::GetSharedPort();
+			if (PingPort > 0 && !Settings.Settings.Contains(UPingSessionsCallbackProxy::PingPortSettingKey))
+				Settings.Set(UPingSessionsCallbackProxy::PingPortSettingKey, PingPort, EOnlineDataAdvertisementType::ViaOnlineService);
 			
 			
 			if (!bDedicatedServer )
@@ -1,6 +1,8 @@
 // Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
 
 #include "FindSessionsCallbackProxyAdvanced.h"
+#include "CompiledSessionFilters.h"
+#include "HAL/IConsoleManager.h"
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -12,11 +14,11 @@ UFindSessionsCallbackProxyAdvanced::UFindSessionsCallbackProxyAdvanced(const FOb
 	, Delegate(FOnFindSessionsCompleteDelegate::CreateUObject(this, &ThisClass::OnCompleted))
 	, bUseLAN(false)
 {
-	bRunSecondSearch = false;
-	bIsOnSecondSearch = false;
+	bAnyQuerySucceeded = false;
+	QueryTimeout = 0.0f;
 }
 
-UFindSessionsCallbackProxyAdvanced* UFindSessionsCallbackProxyAdvanced::FindSessionsAdvanced(UObject* WorldContextObject, class APlayerController* PlayerController, int MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting> &Filters, bool bEmptyServersOnly, bool bNonEmptyServersOnly, bool bSecureServersOnly, int MinSlotsAvailable)
+UFindSessionsCallbackProxyAdvanced* UFindSessionsCallbackProxyAdvanced::FindSessionsAdvanced(UObject* WorldContextObject, class APlayerController* PlayerController, int MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting> &Filters, bool bEmptyServersOnly, bool bNonEmptyServersOnly, bool bSecureServersOnly, int MinSlotsAvailable, float QueryTimeout)
 {
 	UFindSessionsCallbackProxyAdvanced* Proxy = NewObject<UFindSessionsCallbackProxyAdvanced>();	
 	Proxy->PlayerControllerWeakPtr = PlayerController;
@@ -29,6 +31,7 @@ UFindSessionsCallbackProxyAdvanced* UFindSessionsCallbackProxyAdvanced::FindSess
 	Proxy->bNonEmptyServersOnly = bNonEmptyServersOnly;
 	Proxy->bSecureServersOnly = bSecureServersOnly;
 	Proxy->MinSlotsAvailable = MinSlotsAvailable;
+	Proxy->QueryTimeout = QueryTimeout;
 	return Proxy;
 }
 
@@ -43,14 +46,15 @@ void UFindSessionsCallbackProxyAdvanced::Activate()
 		if (Sessions.IsValid())
 		{
 			// Re-initialize here, otherwise I think there might be issues with people re-calling search for some reason before it is destroyed
-			bRunSecondSearch = false;
-			bIsOnSecondSearch = false;
+			Queries.Reset();
+			bAnyQuerySucceeded = false;
 
 			DelegateHandle = Sessions->AddOnFindSessionsCompleteDelegate_Handle(Delegate);
 
-			SearchObject = MakeShareable(new FOnlineSessionSearch);
+			TSharedPtr<FOnlineSessionSearch> SearchObject = MakeShareable(new FOnlineSessionSearch);
 			SearchObject->MaxSearchResults = MaxResults;
 			SearchObject->bIsLanQuery = bUseLAN;
+			Queries.AddDefaulted_GetRef().Search = SearchObject;
 			//SearchObject->QuerySettings.Set(SEARCH_PRESENCE, true, EOnlineComparisonOp::Equals);
 
 			// Create temp filter variable, because I had to re-define a blueprint version of this, it is required.
@@ -120,9 +124,8 @@ void UFindSessionsCallbackProxyAdvanced::Activate()
 				// Only steam uses the separate searching flags currently
 				if (IOnlineSubsystem::DoesInstanceExist("STEAM"))
 				{
-					bRunSecondSearch = true;
-
-					SearchObjectDedicated = MakeShareable(new FOnlineSessionSearch);
+					TSharedPtr<FOnlineSessionSearch> SearchObjectDedicated = MakeShareable(new FOnlineSessionSearch);
+					Queries.AddDefaulted_GetRef().Search = SearchObjectDedicated;
 					SearchObjectDedicated->MaxSearchResults = MaxResults;
 					SearchObjectDedicated->bIsLanQuery = bUseLAN;
 
@@ -139,9 +142,23 @@ void UFindSessionsCallbackProxyAdvanced::Activate()
 			// Copy the derived temp variable over to it's base class
 			SearchObject->QuerySettings = tem;
 
-			Sessions->FindSessions(*Helper.UserID, SearchObject.ToSharedRef());
+			// Issue every query at once, any the session interface refuses while another is pending start when that one finishes
+			for (int32 i = 0; i < Queries.Num(); i++)
+			{
+				// A query that finished straight away may have started the next one already
+				if (Queries[i].bStarted)
+					continue;
+
+				if (!StartQuery(i))
+				{
+					// Someone else's search is pending, ours would never complete
+					if (i == 0)
+						FinishQuery(0, false);
+					break;
+				}
+			}
 
-			// OnQueryCompleted will get called, nothing more to do now
+			// OnCompleted will get called, nothing more to do now
 			return;
 		}
 		else
@@ -154,125 +171,185 @@ void UFindSessionsCallbackProxyAdvanced::Activate()
 	OnFailure.Broadcast(SessionSearchResults);
 }
 
-void UFindSessionsCallbackProxyAdvanced::OnCompleted(bool bSuccess)
+bool UFindSessionsCallbackProxyAdvanced::StartQuery(int32 QueryIndex)
 {
-	FOnlineSubsystemBPCallHelperAdvanced Helper(TEXT("FindSessionsCallback"), GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull));
+	FOnlineSubsystemBPCallHelperAdvanced Helper(TEXT("FindSessions"), GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull));
 	Helper.QueryIDFromPlayerController(PlayerControllerWeakPtr.Get());
 
-	if (!bRunSecondSearch && Helper.IsValid())
+	IOnlineSessionPtr Sessions;
+	if (Helper.IsValid())
+		Sessions = Helper.OnlineSub->GetSessionInterface();
+
+	if (!Sessions.IsValid())
 	{
-		auto Sessions = Helper.OnlineSub->GetSessionInterface();
-		if (Sessions.IsValid())
-		{
-			Sessions->ClearOnFindSessionsCompleteDelegate_Handle(DelegateHandle);
-		}
+		// We lost our player controller
+		FinishQuery(QueryIndex, false);
+		return true;
 	}
 
-	if (bSuccess)
+	FSessionQuery& Query = Queries[QueryIndex];
+	Query.bStarted = true;
+	const bool bIssued = Sessions->FindSessions(*Helper.UserID, Query.Search.ToSharedRef());
+
+	// Subsystems that run one search at a time leave the new search untouched while the other is pending
+	if (Query.Search->SearchState == EOnlineAsyncTaskState::NotStarted)
 	{
-		if (bIsOnSecondSearch)
-		{
-			if (SearchObjectDedicated.IsValid())
-			{
-				// Just log the results for now, will need to add a blueprint-compatible search result struct
-				for (auto& Result : SearchObjectDedicated->SearchResults)
-				{
-					FString ResultText = FString::Printf(TEXT("Found a session. Ping is %d"), Result.PingInMs);
+		Query.bStarted = false;
+		return false;
+	}
 
-					FFrame::KismetExecutionMessage(*ResultText, ELogVerbosity::Log);
+	if (!bIssued)
+	{
+		if (!Query.bFinished)
+			FinishQuery(QueryIndex, false);
+		return true;
+	}
 
-					FBlueprintSessionResult BPResult;
-					BPResult.OnlineResult = Result;
-					SessionSearchResults.Add(BPResult);
-				}
-				OnSuccess.Broadcast(SessionSearchResults);
-				return;
-			}
-		}
-		else
-		{
-			if (SearchObject.IsValid())
-			{
-				// Just log the results for now, will need to add a blueprint-compatible search result struct
-				for (auto& Result : SearchObject->SearchResults)
-				{
-					FString ResultText = FString::Printf(TEXT("Found a session. Ping is %d"), Result.PingInMs);
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+	if (QueryTimeout > 0.0f && World && !Query.bFinished)
+	{
+		World->GetTimerManager().SetTimer(Query.TimeoutHandle, FTimerDelegate::CreateUObject(this, &ThisClass::OnQueryTimedOut, QueryIndex), QueryTimeout, false);
+	}
 
-					FFrame::KismetExecutionMessage(*ResultText, ELogVerbosity::Log);
+	return true;
+}
 
-					FBlueprintSessionResult BPResult;
-					BPResult.OnlineResult = Result;
-					SessionSearchResults.Add(BPResult);
-				}
-				if (!bRunSecondSearch)
-				{
-					OnSuccess.Broadcast(SessionSearchResults);
-					return;
-				}
-			}
-		}
-	}
-	else
+void UFindSessionsCallbackProxyAdvanced::OnCompleted(bool bSuccess)
+{
+	// The delegate does not say which search finished, and may be for someone else's search entirely, the search states do say
+	for (int32 i = 0; i < Queries.Num(); i++)
 	{
-		if (!bRunSecondSearch)
+		const FSessionQuery& Query = Queries[i];
+		if (!Query.bStarted || Query.bFinished)
+			continue;
+
+		const EOnlineAsyncTaskState::Type SearchState = Query.Search->SearchState;
+		if (SearchState == EOnlineAsyncTaskState::Done || SearchState == EOnlineAsyncTaskState::Failed)
 		{
-			// Need to account for only one of the searches failing
-			if (SessionSearchResults.Num() > 0)
-				OnSuccess.Broadcast(SessionSearchResults);
-			else
-				OnFailure.Broadcast(SessionSearchResults);
-			return;
+			FinishQuery(i, SearchState == EOnlineAsyncTaskState::Done);
 		}
 	}
+}
 
-	if (Helper.IsValid() && bRunSecondSearch && ServerSearchType == EBPServerPresenceSearchType::AllServers)
+void UFindSessionsCallbackProxyAdvanced::FinishQuery(int32 QueryIndex, bool bSucceeded)
+{
+	FSessionQuery& Query = Queries[QueryIndex];
+	Query.bStarted = true;
+	Query.bFinished = true;
+
+	if (UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull))
 	{
-		bRunSecondSearch = false;
-		bIsOnSecondSearch = true;
-		auto Sessions = Helper.OnlineSub->GetSessionInterface();
-		Sessions->FindSessions(*Helper.UserID, SearchObjectDedicated.ToSharedRef());
+		World->GetTimerManager().ClearTimer(Query.TimeoutHandle);
 	}
-	else // We lost our player controller
+
+	TArray<FBlueprintSessionResult> QueryResults;
+	if (bSucceeded)
 	{
-		if (bSuccess && SessionSearchResults.Num() > 0)
-			OnSuccess.Broadcast(SessionSearchResults);
-		else
-			OnFailure.Broadcast(SessionSearchResults);
+		bAnyQuerySucceeded = true;
+		CollectQueryResults(QueryIndex, QueryResults);
+	}
+
+	bool bAllFinished = true;
+	for (const FSessionQuery& Other : Queries)
+	{
+		bAllFinished &= Other.bFinished;
+	}
+
+	if (bAllFinished)
+	{
+		FinishSearch();
+		return;
+	}
+
+	if (QueryResults.Num() > 0)
+	{
+		OnPartialResults.Broadcast(QueryResults);
+	}
+
+	// Sequential fallback, the session interface is free now
+	for (int32 i = 0; i < Queries.Num(); i++)
+	{
+		if (!Queries[i].bStarted)
+		{
+			if (!StartQuery(i))
+				FinishQuery(i, false);
+			break;
+		}
 	}
 }
 
+void UFindSessionsCallbackProxyAdvanced::CollectQueryResults(int32 QueryIndex, TArray<FBlueprintSessionResult>& OutNewResults)
+{
+	FSessionQuery& Query = Queries[QueryIndex];
+	const TArray<FOnlineSessionSearchResult>& Results = Query.Search->SearchResults;
+	for (int32 i = Query.NumCollected; i < Results.Num(); i++)
+	{
+		FString ResultText = FString::Printf(TEXT("Found a session. Ping is %d"), Results[i].PingInMs);
 
-void UFindSessionsCallbackProxyAdvanced::FilterSessionResults(const TArray<FBlueprintSessionResult> &SessionResults, const TArray<FSessionsSearchSetting> &Filters, TArray<FBlueprintSessionResult> &FilteredResults)
+		FFrame::KismetExecutionMessage(*ResultText, ELogVerbosity::Log);
+
+		FBlueprintSessionResult BPResult;
+		BPResult.OnlineResult = Results[i];
+		OutNewResults.Add(BPResult);
+	}
+	Query.NumCollected = Results.Num();
+
+	SessionSearchResults.Append(OutNewResults);
+}
+
+void UFindSessionsCallbackProxyAdvanced::OnQueryTimedOut(int32 QueryIndex)
 {
-	for (int j = 0; j < SessionResults.Num(); j++)
+	if (!Queries.IsValidIndex(QueryIndex) || Queries[QueryIndex].bFinished)
+		return;
+
+	FFrame::KismetExecutionMessage(*FString::Printf(TEXT("Session search %d timed out after %.1f seconds"), QueryIndex, QueryTimeout), ELogVerbosity::Warning);
+
+	// A query still waiting its turn would be refused until the timed out search is cancelled
+	bool bAnyWaiting = false;
+	for (const FSessionQuery& Query : Queries)
 	{
-		bool bAddResult = true;
+		bAnyWaiting |= !Query.bStarted;
+	}
 
-		// Filter results
-		if (Filters.Num() > 0)
+	// CancelFindSessions cancels whatever search the interface has pending, only call it while that is the timed out one
+	const TSharedPtr<FOnlineSessionSearch>& TimedOutSearch = Queries[QueryIndex].Search;
+	if (bAnyWaiting && TimedOutSearch.IsValid() && TimedOutSearch->SearchState == EOnlineAsyncTaskState::InProgress)
+	{
+		FOnlineSubsystemBPCallHelperAdvanced Helper(TEXT("FindSessionsTimeout"), GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull));
+		if (Helper.OnlineSub != nullptr)
 		{
-			const FOnlineSessionSetting * setting;
-			for (int i = 0; i < Filters.Num(); i++)
-			{
-				setting = SessionResults[j].OnlineResult.Session.SessionSettings.Settings.Find(Filters[i].PropertyKeyPair.Key);
+			auto Sessions = Helper.OnlineSub->GetSessionInterface();
+			if (Sessions.IsValid())
+				Sessions->CancelFindSessions();
+		}
+	}
 
-				// Couldn't find this key
-				if (!setting)
-					continue;
+	FinishQuery(QueryIndex, false);
+}
 
-				if (!CompareVariants(setting->Data, Filters[i].PropertyKeyPair.Data, Filters[i].ComparisonOp))
-				{
-					bAddResult = false;
-					break;
-				}
-			}
+void UFindSessionsCallbackProxyAdvanced::FinishSearch()
+{
+	FOnlineSubsystemBPCallHelperAdvanced Helper(TEXT("FindSessionsCallback"), GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull));
+	if (Helper.OnlineSub != nullptr)
+	{
+		auto Sessions = Helper.OnlineSub->GetSessionInterface();
+		if (Sessions.IsValid())
+		{
+			Sessions->ClearOnFindSessionsCompleteDelegate_Handle(DelegateHandle);
 		}
-
-		if (bAddResult)
-			FilteredResults.Add(SessionResults[j]);
 	}
 
-	return;
+	// Need to account for only one of the searches failing
+	if (bAnyQuerySucceeded || SessionSearchResults.Num() > 0)
+		OnSuccess.Broadcast(SessionSearchResults);
+	else
+		OnFailure.Broadcast(SessionSearchResults);
+}
+
+
+void UFindSessionsCallbackProxyAdvanced::FilterSessionResults(const TArray<FBlueprintSessionResult> &SessionResults, const TArray<FSessionsSearchSetting> &Filters, TArray<FBlueprintSessionResult> &FilteredResults)
+{
+	FCompiledSessionFilters(Filters).Filter(SessionResults, FilteredResults);
 }
 
 
@@ -418,4 +495,126 @@ bool UFindSessionsCallbackProxyAdvanced::CompareVariants(const FVariantData &A,
 
 
 
-}
\ No newline at end of file
+}
+
+
+namespace
+{
+	// The filtering FilterSessionResults used to do, a map lookup and a type switch per result and filter. Kept to benchmark against
+	void FilterSessionResultsPerPair(const TArray<FBlueprintSessionResult> &SessionResults, const TArray<FSessionsSearchSetting> &Filters, TArray<FBlueprintSessionResult> &FilteredResults)
+	{
+		for (int j = 0; j < SessionResults.Num(); j++)
+		{
+			bool bAddResult = true;
+
+			// Filter results
+			if (Filters.Num() > 0)
+			{
+				const FOnlineSessionSetting * setting;
+				for (int i = 0; i < Filters.Num(); i++)
+				{
+					setting = SessionResults[j].OnlineResult.Session.SessionSettings.Settings.Find(Filters[i].PropertyKeyPair.Key);
+
+					// Couldn't find this key
+					if (!setting)
+						continue;
+
+					if (!UFindSessionsCallbackProxyAdvanced::CompareVariants(setting->Data, Filters[i].PropertyKeyPair.Data, Filters[i].ComparisonOp))
+					{
+						bAddResult = false;
+						break;
+					}
+				}
+			}
+
+			if (bAddResult)
+				FilteredResults.Add(SessionResults[j]);
+		}
+
+		return;
+	}
+
+	void MakeBenchmarkResults(int32 NumResults, TArray<FBlueprintSessionResult>& OutResults)
+	{
+		static const TCHAR* GameModes[] = { TEXT("TDM"), TEXT("FFA"), TEXT("CTF") };
+		static const TCHAR* MapNames[] = { TEXT("Warehouse"), TEXT("Docks"), TEXT("Tower"), TEXT("Yard") };
+
+		FRandomStream Random(NumResults);
+		OutResults.SetNum(NumResults);
+		for (FBlueprintSessionResult& Result : OutResults)
+		{
+			FOnlineSessionSettings& Settings = Result.OnlineResult.Session.SessionSettings;
+			Settings.Set(FName(TEXT("GAMEMODE")), FString(GameModes[Random.RandHelper(ARRAY_COUNT(GameModes))]), EOnlineDataAdvertisementType::ViaOnlineService);
+			Settings.Set(FName(TEXT("MAPNAME")), FString(MapNames[Random.RandHelper(ARRAY_COUNT(MapNames))]), EOnlineDataAdvertisementType::ViaOnlineService);
+			Settings.Set(FName(TEXT("SKILL")), Random.RandRange(0, 100), EOnlineDataAdvertisementType::ViaOnlineService);
+			Settings.Set(FName(TEXT("RANKED")), Random.RandHelper(2) == 0, EOnlineDataAdvertisementType::ViaOnlineService);
+			Settings.Set(FName(TEXT("TICKRATE")), Random.FRandRange(30.0f, 128.0f), EOnlineDataAdvertisementType::ViaOnlineService);
+		}
+	}
+
+	void AddBenchmarkFilter(TArray<FSessionsSearchSetting>& Filters, const TCHAR* Key, const FVariantData& Data, EOnlineComparisonOpRedux ComparisonOp)
+	{
+		FSessionsSearchSetting& Filter = Filters.AddDefaulted_GetRef();
+		Filter.PropertyKeyPair.Key = FName(Key);
+		Filter.PropertyKeyPair.Data = Data;
+		Filter.ComparisonOp = ComparisonOp;
+	}
+
+	// Times the per pair filtering against compiled filters, e.g. "AdvancedSessions.BenchmarkFilters 1000 10000"
+	FAutoConsoleCommand BenchmarkFiltersCommand(
+		TEXT("AdvancedSessions.BenchmarkFilters"),
+		TEXT("Times FilterSessionResults against the old per pair filtering. Takes the result counts to run, 1000 and 10000 by default."),
+		FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+		{
+			TArray<int32> ResultCounts;
+			for (const FString& Arg : Args)
+			{
+				ResultCounts.Add(FMath::Max(FCString::Atoi(*Arg), 1));
+			}
+			if (ResultCounts.Num() == 0)
+			{
+				ResultCounts.Add(1000);
+				ResultCounts.Add(10000);
+			}
+
+			TArray<FSessionsSearchSetting> Filters;
+			AddBenchmarkFilter(Filters, TEXT("GAMEMODE"), FVariantData(FString(TEXT("TDM"))), EOnlineComparisonOpRedux::NotEquals);
+			AddBenchmarkFilter(Filters, TEXT("MAPNAME"), FVariantData(FString(TEXT("Tower"))), EOnlineComparisonOpRedux::NotEquals);
+			AddBenchmarkFilter(Filters, TEXT("SKILL"), FVariantData(20), EOnlineComparisonOpRedux::GreaterThanEquals);
+			AddBenchmarkFilter(Filters, TEXT("TICKRATE"), FVariantData(60.0f), EOnlineComparisonOpRedux::GreaterThan);
+			AddBenchmarkFilter(Filters, TEXT("RANKED"), FVariantData(true), EOnlineComparisonOpRedux::Equals);
+
+			const int32 Iterations = 20;
+			for (const int32 NumResults : ResultCounts)
+			{
+				TArray<FBlueprintSessionResult> Results;
+				MakeBenchmarkResults(NumResults, Results);
+
+				TArray<FBlueprintSessionResult> PerPairResults;
+				TArray<FBlueprintSessionResult> CompiledResults;
+
+				double PerPairSeconds = 0.0;
+				double CompiledSeconds = 0.0;
+				for (int32 i = 0; i < Iterations; i++)
+				{
+					PerPairResults.Reset();
+					double StartTime = FPlatformTime::Seconds();
+					FilterSessionResultsPerPair(Results, Filters, PerPairResults);
+					PerPairSeconds += FPlatformTime::Seconds() - StartTime;
+
+					// Compiling is part of every call, as it is in FilterSessionResults
+					CompiledResults.Reset();
+					StartTime = FPlatformTime::Seconds();
+					UFindSessionsCallbackProxyAdvanced::FilterSessionResults(Results, Filters, CompiledResults);
+					CompiledSeconds += FPlatformTime::Seconds() - StartTime;
+				}
+
+				UE_LOG(AdvancedSessionFilterLog, Display, TEXT("%d results, %d filters: per pair %.3f ms, compiled %.3f ms (%s), %d passed%s"),
+					NumResults, Filters.Num(),
+					PerPairSeconds * 1000.0 / Iterations, CompiledSeconds * 1000.0 / Iterations,
+					NumResults >= FCompiledSessionFilters::ParallelThreshold ? TEXT("parallel") : TEXT("single thread"),
+					CompiledResults.Num(),
+					CompiledResults.Num() == PerPairResults.Num() ? TEXT("") : TEXT(", RESULTS DIFFER"));
+			}
+		}));
+}
@@ -0,0 +1,172 @@
+// Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
+
+#include "FindSessionsStreamingCallbackProxy.h"
+#include "TimerManager.h"
+
+
+//////////////////////////////////////////////////////////////////////////
+// UFindSessionsStreamingCallbackProxy
+
+
+UFindSessionsStreamingCallbackProxy::UFindSessionsStreamingCallbackProxy(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	PageSize = 20;
+	CancelAfterResults = 0;
+	bSearchFinished = false;
+	bCancelled = false;
+}
+
+UFindSessionsStreamingCallbackProxy* UFindSessionsStreamingCallbackProxy::FindSessionsStreaming(UObject* WorldContextObject, class APlayerController* PlayerController, int32 MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting> &Filters, bool bEmptyServersOnly, bool bNonEmptyServersOnly, bool bSecureServersOnly, int MinSlotsAvailable, float QueryTimeout, int32 PageSize, int32 CancelAfterResults)
+{
+	UFindSessionsStreamingCallbackProxy* Proxy = NewObject<UFindSessionsStreamingCallbackProxy>();
+	Proxy->PlayerControllerWeakPtr = PlayerController;
+	Proxy->bUseLAN = bUseLAN;
+	Proxy->MaxResults = MaxResults;
+	Proxy->WorldContextObject = WorldContextObject;
+	Proxy->SearchSettings = Filters;
+	Proxy->ServerSearchType = ServerTypeToSearch;
+	Proxy->bEmptyServersOnly = bEmptyServersOnly;
+	Proxy->bNonEmptyServersOnly = bNonEmptyServersOnly;
+	Proxy->bSecureServersOnly = bSecureServersOnly;
+	Proxy->MinSlotsAvailable = MinSlotsAvailable;
+	Proxy->QueryTimeout = QueryTimeout;
+	Proxy->PageSize = PageSize;
+	Proxy->CancelAfterResults = CancelAfterResults;
+	return Proxy;
+}
+
+void UFindSessionsStreamingCallbackProxy::Activate()
+{
+	PendingPageResults.Reset();
+	SeenSessionIds.Reset();
+	SessionSearchResults.Reset();
+	bSearchFinished = false;
+	bCancelled = false;
+
+	Super::Activate();
+
+	// No queries means the search failed to start and OnFailure was already sent
+	if (Queries.Num() > 0)
+		SchedulePoll();
+}
+
+void UFindSessionsStreamingCallbackProxy::SchedulePoll()
+{
+	if (UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull))
+	{
+		World->GetTimerManager().SetTimerForNextTick(FTimerDelegate::CreateUObject(this, &ThisClass::PollResults));
+	}
+	else
+	{
+		// Nothing left to tick us, send what there is
+		PendingPageResults.Reset();
+		Super::FinishSearch();
+	}
+}
+
+void UFindSessionsStreamingCallbackProxy::PollResults()
+{
+	if (!bSearchFinished)
+	{
+		// Some subsystems add results while their search is still running
+		for (int32 i = 0; i < Queries.Num(); i++)
+		{
+			if (Queries[i].bStarted && !Queries[i].bFinished)
+			{
+				TArray<FBlueprintSessionResult> NewResults;
+				CollectQueryResults(i, NewResults);
+			}
+		}
+
+		if (CancelAfterResults > 0 && SessionSearchResults.Num() >= CancelAfterResults)
+			CancelSearch();
+	}
+
+	// One page a frame keeps the browser from rebuilding a huge list at once
+	if (PendingPageResults.Num() > 0)
+	{
+		const int32 PageCount = PageSize > 0 ? FMath::Min(PageSize, PendingPageResults.Num()) : PendingPageResults.Num();
+		TArray<FBlueprintSessionResult> Page(PendingPageResults.GetData(), PageCount);
+		PendingPageResults.RemoveAt(0, PageCount, false);
+		OnResultsPage.Broadcast(Page);
+	}
+
+	if (bSearchFinished && PendingPageResults.Num() == 0)
+	{
+		Super::FinishSearch();
+		return;
+	}
+
+	SchedulePoll();
+}
+
+void UFindSessionsStreamingCallbackProxy::CollectQueryResults(int32 QueryIndex, TArray<FBlueprintSessionResult>& OutNewResults)
+{
+	FSessionQuery& Query = Queries[QueryIndex];
+	const TArray<FOnlineSessionSearchResult>& Results = Query.Search->SearchResults;
+	for (int32 i = Query.NumCollected; i < Results.Num(); i++)
+	{
+		if (CancelAfterResults > 0 && SessionSearchResults.Num() >= CancelAfterResults)
+			break;
+
+		// The listen and dedicated server searches can both find the same session
+		const FString SessionId = Results[i].GetSessionIdStr();
+		if (!SessionId.IsEmpty())
+		{
+			bool bAlreadySeen = false;
+			SeenSessionIds.Add(SessionId, &bAlreadySeen);
+			if (bAlreadySeen)
+				continue;
+		}
+
+		FBlueprintSessionResult BPResult;
+		BPResult.OnlineResult = Results[i];
+		OutNewResults.Add(BPResult);
+	}
+	Query.NumCollected = Results.Num();
+
+	SessionSearchResults.Append(OutNewResults);
+	PendingPageResults.Append(OutNewResults);
+}
+
+void UFindSessionsStreamingCallbackProxy::CancelSearch()
+{
+	bCancelled = true;
+
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::ReturnNull);
+
+	bool bAnyRunning = false;
+	for (FSessionQuery& Query : Queries)
+	{
+		// CancelFindSessions cancels whatever search the interface has pending, which may not be one of ours
+		if (Query.bStarted && !Query.bFinished && Query.Search.IsValid() && Query.Search->SearchState == EOnlineAsyncTaskState::InProgress)
+			bAnyRunning = true;
+
+		if (World)
+			World->GetTimerManager().ClearTimer(Query.TimeoutHandle);
+
+		// Queries waiting their turn are never started
+		Query.bStarted = true;
+		Query.bFinished = true;
+	}
+
+	if (bAnyRunning)
+	{
+		FOnlineSubsystemBPCallHelperAdvanced Helper(TEXT("FindSessionsStreamingCancel"), World);
+		if (Helper.OnlineSub != nullptr)
+		{
+			auto Sessions = Helper.OnlineSub->GetSessionInterface();
+			if (Sessions.IsValid())
+				Sessions->CancelFindSessions();
+		}
+	}
+
+	FinishSearch();
+}
+
+void UFindSessionsStreamingCallbackProxy::FinishSearch()
+{
+	// The last pages still have to go out, PollResults finishes once they have
+	bSearchFinished = true;
+}
@@ -0,0 +1,210 @@
+// Copyright 1998-2015 Epic Games, Inc. All Rights Reserved.
+
+#include "PingSessionsCallbackProxy.h"
+#include "SessionPingProber.h"
+#include "Algo/StableSort.h"
+
+const FName UPingSessionsCallbackProxy::PingPortSettingKey(TEXT("PINGPORT"));
+
+//////////////////////////////////////////////////////////////////////////
+// UPingSessionsCallbackProxy
+
+
+UPingSessionsCallbackProxy::UPingSessionsCallbackProxy(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+	MaxInFlight = 8;
+	Timeout = 1.0f;
+	ProbePortOffset = 10;
+	MinSlotsAvailable = 0;
+}
+
+UPingSessionsCallbackProxy* UPingSessionsCallbackProxy::PingSessions(UObject* WorldContextObject, const TArray<FBlueprintSessionResult>& SessionResults, FSessionRankWeights Weights, int32 MaxInFlight, float Timeout, int32 ProbePortOffset, int MinSlotsAvailable)
+{
+	UPingSessionsCallbackProxy* Proxy = NewObject<UPingSessionsCallbackProxy>();
+	Proxy->WorldContextObject = WorldContextObject;
+	Proxy->SessionResults = SessionResults;
+	Proxy->Weights = Weights;
+	Proxy->MaxInFlight = MaxInFlight;
+	Proxy->Timeout = Timeout;
+	Proxy->ProbePortOffset = ProbePortOffset;
+	Proxy->MinSlotsAvailable = MinSlotsAvailable;
+	return Proxy;
+}
+
+void UPingSessionsCallbackProxy::Activate()
+{
+	FOnlineSubsystemBPCallHelperAdvanced Helper(TEXT("PingSessions"), GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull));
+
+	IOnlineSessionPtr Sessions;
+	if (Helper.OnlineSub != nullptr)
+		Sessions = Helper.OnlineSub->GetSessionInterface();
+
+	if (!Sessions.IsValid())
+	{
+		FFrame::KismetExecutionMessage(TEXT("Sessions not supported by Online Subsystem"), ELogVerbosity::Warning);
+		Finish(false);
+		return;
+	}
+
+	// Only sessions with an IP address can be probed, steam relay addresses and the like keep their reported ping
+	TArray<FIPv4Endpoint> Targets;
+	for (int32 i = 0; i < SessionResults.Num(); i++)
+	{
+		const FOnlineSessionSearchResult& Result = SessionResults[i].OnlineResult;
+
+		FString ConnectInfo;
+		FIPv4Endpoint Endpoint;
+		if (!Sessions->GetResolvedConnectString(Result, NAME_GamePort, ConnectInfo) || !FIPv4Endpoint::Parse(ConnectInfo, Endpoint))
+			continue;
+
+		int32 PingPort = 0;
+		if (!Result.Session.SessionSettings.Get(PingPortSettingKey, PingPort))
+			PingPort = Endpoint.Port + ProbePortOffset;
+
+		if (PingPort <= 0 || PingPort > MAX_uint16)
+			continue;
+
+		Endpoint.Port = (uint16)PingPort;
+		Targets.Add(Endpoint);
+		TargetResultIndices.Add(i);
+	}
+
+	if (Targets.Num() == 0)
+	{
+		Finish(false);
+		return;
+	}
+
+	Prober = MakeShared<FSessionPingProber, ESPMode::ThreadSafe>(Targets, MaxInFlight, Timeout);
+	Prober->OnTargetPinged.BindUObject(this, &UPingSessionsCallbackProxy::OnTargetPinged);
+	Prober->OnAllPinged.BindUObject(this, &UPingSessionsCallbackProxy::OnAllPinged);
+
+	if (!Prober->Start())
+	{
+		Prober.Reset();
+		Finish(false);
+	}
+}
+
+void UPingSessionsCallbackProxy::BeginDestroy()
+{
+	if (Prober.IsValid())
+	{
+		Prober->Cancel();
+		Prober.Reset();
+	}
+
+	Super::BeginDestroy();
+}
+
+void UPingSessionsCallbackProxy::OnTargetPinged(int32 TargetIndex, int32 PingInMs)
+{
+	const int32 ResultIndex = TargetResultIndices[TargetIndex];
+	if (PingInMs >= 0)
+		SessionResults[ResultIndex].OnlineResult.PingInMs = PingInMs;
+
+	OnPinged.Broadcast(ResultIndex, SessionResults[ResultIndex]);
+}
+
+void UPingSessionsCallbackProxy::OnAllPinged()
+{
+	Prober.Reset();
+	Finish(true);
+}
+
+void UPingSessionsCallbackProxy::Finish(bool bSucceeded)
+{
+	TArray<FBlueprintSessionResult> RankedResults;
+	RankSessionResults(SessionResults, Weights, MinSlotsAvailable, RankedResults);
+
+	if (bSucceeded)
+		OnSuccess.Broadcast(RankedResults);
+	else
+		OnFailure.Broadcast(RankedResults);
+}
+
+float UPingSessionsCallbackProxy::GetSessionScore(const FBlueprintSessionResult& Result, FSessionRankWeights Weights)
+{
+	float Score = Result.OnlineResult.Session.NumOpenPublicConnections * Weights.FreeSlotWeight - Result.OnlineResult.PingInMs * Weights.PingWeight;
+
+	if (Weights.CustomSettingKey.IsNone() || Weights.CustomSettingWeight == 0.0f)
+		return Score;
+
+	const FOnlineSessionSetting* Setting = Result.OnlineResult.Session.SessionSettings.Settings.Find(Weights.CustomSettingKey);
+	if (!Setting)
+		return Score;
+
+	float Value = 0.0f;
+	switch (Setting->Data.GetType())
+	{
+	case EOnlineKeyValuePairDataType::Int32:
+	{
+		int32 Data = 0;
+		Setting->Data.GetValue(Data);
+		Value = (float)Data;
+		break;
+	}
+	case EOnlineKeyValuePairDataType::Int64:
+	{
+		int64 Data = 0;
+		Setting->Data.GetValue(Data);
+		Value = (float)Data;
+		break;
+	}
+	case EOnlineKeyValuePairDataType::Float:
+		Setting->Data.GetValue(Value);
+		break;
+	case EOnlineKeyValuePairDataType::Double:
+	{
+		double Data = 0.0;
+		Setting->Data.GetValue(Data);
+		Value = (float)Data;
+		break;
+	}
+	case EOnlineKeyValuePairDataType::Bool:
+	{
+		bool bData = false;
+		Setting->Data.GetValue(bData);
+		Value = bData ? 1.0f : 0.0f;
+		break;
+	}
+	default:
+		break;
+	}
+
+	return Score + Value * Weights.CustomSettingWeight;
+}
+
+void UPingSessionsCallbackProxy::RankSessionResults(const TArray<FBlueprintSessionResult>& SessionResults, FSessionRankWeights Weights, int MinSlotsAvailable, TArray<FBlueprintSessionResult>& RankedResults)
+{
+	RankSessionResultsBy(SessionResults, [&Weights](const FBlueprintSessionResult& Result) { return GetSessionScore(Result, Weights); }, MinSlotsAvailable, RankedResults);
+}
+
+void UPingSessionsCallbackProxy::RankSessionResultsBy(const TArray<FBlueprintSessionResult>& SessionResults, TFunctionRef<float(const FBlueprintSessionResult&)> Score, int MinSlotsAvailable, TArray<FBlueprintSessionResult>& RankedResults)
+{
+	struct FScoredResult
+	{
+		int32 Index;
+		float Score;
+	};
+
+	// Scored once each, the sort only moves indices
+	TArray<FScoredResult> Scored;
+	Scored.Reserve(SessionResults.Num());
+	for (int32 i = 0; i < SessionResults.Num(); i++)
+	{
+		if (SessionResults[i].OnlineResult.Session.NumOpenPublicConnections < MinSlotsAvailable)
+			continue;
+
+		Scored.Add({ i, Score(SessionResults[i]) });
+	}
+
+	Algo::StableSort(Scored, [](const FScoredResult& A, const FScoredResult& B) { return A.Score > B.Score; });
+
+	RankedResults.Reset(Scored.Num());
+	for (const FScoredResult& Result : Scored)
+	{
+		RankedResults.Add(SessionResults[Result.Index]);
+	}
+}
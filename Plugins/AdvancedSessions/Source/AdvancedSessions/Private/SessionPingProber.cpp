@@ -0,0 +1,344 @@
+#include "SessionPingProber.h"
+#include "Common/UdpSocketBuilder.h"
+#include "Common/UdpSocketReceiver.h"
+#include "Containers/Ticker.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/ArrayReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+
+DEFINE_LOG_CATEGORY(AdvancedSessionPingLog);
+
+namespace
+{
+	// Reads a probe or reply, false if the packet is not one
+	bool ReadProbe(FArrayReader& Packet, uint32& OutTargetIndex)
+	{
+		if (Packet.Num() != FSessionPingProber::ProbeSize)
+			return false;
+
+		uint32 Magic = 0;
+		Packet << Magic;
+		Packet << OutTargetIndex;
+		return Magic == FSessionPingProber::ProbeMagic;
+	}
+
+	void DestroySocket(FSocket*& Socket)
+	{
+		if (Socket)
+		{
+			Socket->Close();
+			ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+			Socket = nullptr;
+		}
+	}
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// FSessionPingProber
+
+FSessionPingProber::FSessionPingProber(const TArray<FIPv4Endpoint>& InTargets, int32 InMaxInFlight, float InTimeoutSeconds)
+	: Targets(InTargets)
+	, NextTarget(0)
+	, NumFinished(0)
+	, MaxInFlight(FMath::Max(InMaxInFlight, 1))
+	, TimeoutSeconds(FMath::Max(InTimeoutSeconds, 0.01f))
+	, Inbox(MakeShared<FReplyInbox, ESPMode::ThreadSafe>())
+	, Socket(nullptr)
+	, Receiver(nullptr)
+{
+	SendTimes.SetNumZeroed(Targets.Num());
+	Finished.SetNumZeroed(Targets.Num());
+}
+
+FSessionPingProber::~FSessionPingProber()
+{
+	Cancel();
+}
+
+bool FSessionPingProber::Start()
+{
+	Socket = FUdpSocketBuilder(TEXT("SessionPingProber"))
+		.AsNonBlocking()
+		.BoundToEndpoint(FIPv4Endpoint::Any)
+		.WithReceiveBufferSize(64 * 1024)
+		.Build();
+
+	if (!Socket)
+	{
+		UE_LOG(AdvancedSessionPingLog, Warning, TEXT("Could not open a socket to ping sessions from"));
+		return false;
+	}
+
+	TSharedRef<FReplyInbox, ESPMode::ThreadSafe> ReplyInbox = Inbox;
+	Receiver = new FUdpSocketReceiver(Socket, FTimespan::FromMilliseconds(10), TEXT("SessionPingProber"));
+	Receiver->OnDataReceived().BindLambda([ReplyInbox](const FArrayReaderPtr& Packet, const FIPv4Endpoint& Sender)
+	{
+		FReplyInbox::FReply Reply;
+		Reply.ReceiveTime = FPlatformTime::Seconds();
+		Reply.Sender = Sender;
+		if (ReadProbe(*Packet, Reply.TargetIndex))
+			ReplyInbox->Replies.Enqueue(Reply);
+	});
+	Receiver->Start();
+
+	TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateThreadSafeSP(this, &FSessionPingProber::Tick));
+	return true;
+}
+
+void FSessionPingProber::Cancel()
+{
+	if (TickHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+		TickHandle.Reset();
+	}
+
+	CloseSocket();
+}
+
+void FSessionPingProber::CloseSocket()
+{
+	// Stops and joins the receive thread before the socket goes
+	delete Receiver;
+	Receiver = nullptr;
+
+	DestroySocket(Socket);
+}
+
+bool FSessionPingProber::Tick(float DeltaTime)
+{
+	// A callback may drop the last reference to us
+	TSharedRef<FSessionPingProber, ESPMode::ThreadSafe> KeepAlive = AsShared();
+
+	FReplyInbox::FReply Reply;
+	while (Inbox->Replies.Dequeue(Reply))
+	{
+		const int32 TargetIndex = (int32)Reply.TargetIndex;
+
+		// Late replies to timed out probes are ignored
+		if (!Targets.IsValidIndex(TargetIndex) || Finished[TargetIndex] || SendTimes[TargetIndex] == 0.0)
+			continue;
+
+		// Only the target itself may answer for it, anyone else could set its ping by echoing the index
+		if (Reply.Sender != Targets[TargetIndex])
+			continue;
+
+		InFlight.RemoveSingleSwap(TargetIndex, false);
+		FinishTarget(TargetIndex, FMath::Max(FMath::RoundToInt((Reply.ReceiveTime - SendTimes[TargetIndex]) * 1000.0), 0));
+		if (!TickHandle.IsValid())
+			return false;
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	for (int32 i = InFlight.Num() - 1; i >= 0; i--)
+	{
+		const int32 TargetIndex = InFlight[i];
+		if (Now - SendTimes[TargetIndex] > TimeoutSeconds)
+		{
+			InFlight.RemoveAtSwap(i, 1, false);
+			FinishTarget(TargetIndex, -1);
+			if (!TickHandle.IsValid())
+				return false;
+		}
+	}
+
+	while (InFlight.Num() < MaxInFlight && NextTarget < Targets.Num())
+	{
+		SendProbe(NextTarget++);
+	}
+
+	if (NumFinished == Targets.Num())
+	{
+		TickHandle.Reset();
+		CloseSocket();
+		OnAllPinged.ExecuteIfBound();
+		return false;
+	}
+
+	return true;
+}
+
+void FSessionPingProber::SendProbe(int32 TargetIndex)
+{
+	TArray<uint8> Packet;
+	FMemoryWriter Writer(Packet);
+	uint32 Magic = ProbeMagic;
+	uint32 Index = (uint32)TargetIndex;
+	Writer << Magic;
+	Writer << Index;
+
+	SendTimes[TargetIndex] = FPlatformTime::Seconds();
+
+	int32 BytesSent = 0;
+	if (!Socket->SendTo(Packet.GetData(), Packet.Num(), BytesSent, *Targets[TargetIndex].ToInternetAddr()))
+	{
+		// Unreachable right away, no point waiting for the timeout
+		FinishTarget(TargetIndex, -1);
+		return;
+	}
+
+	InFlight.Add(TargetIndex);
+}
+
+void FSessionPingProber::FinishTarget(int32 TargetIndex, int32 PingInMs)
+{
+	Finished[TargetIndex] = true;
+	NumFinished++;
+	OnTargetPinged.ExecuteIfBound(TargetIndex, PingInMs);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// FSessionPingResponder
+
+FSessionPingResponder::FSessionPingResponder(int32 InPort)
+	: Port(InPort)
+	, Socket(nullptr)
+	, Receiver(nullptr)
+{
+	Socket = FUdpSocketBuilder(TEXT("SessionPingResponder"))
+		.AsNonBlocking()
+		.AsReusable()
+		.BoundToEndpoint(FIPv4Endpoint(FIPv4Address::Any, (uint16)Port))
+		.WithReceiveBufferSize(64 * 1024)
+		.Build();
+
+	if (!Socket)
+	{
+		UE_LOG(AdvancedSessionPingLog, Warning, TEXT("Could not listen for session pings on port %d"), Port);
+		return;
+	}
+
+	// Replies go out from the receive thread, the game thread never sees a probe
+	FSocket* EchoSocket = Socket;
+	Receiver = new FUdpSocketReceiver(Socket, FTimespan::FromMilliseconds(100), TEXT("SessionPingResponder"));
+	Receiver->OnDataReceived().BindLambda([EchoSocket](const FArrayReaderPtr& Packet, const FIPv4Endpoint& Sender)
+	{
+		// Only probes are answered, and never with more than they sent
+		uint32 TargetIndex = 0;
+		if (!ReadProbe(*Packet, TargetIndex))
+			return;
+
+		int32 BytesSent = 0;
+		EchoSocket->SendTo(Packet->GetData(), Packet->Num(), BytesSent, *Sender.ToInternetAddr());
+	});
+	Receiver->Start();
+
+	UE_LOG(AdvancedSessionPingLog, Log, TEXT("Answering session pings on port %d"), Port);
+}
+
+FSessionPingResponder::~FSessionPingResponder()
+{
+	delete Receiver;
+	Receiver = nullptr;
+
+	DestroySocket(Socket);
+}
+
+namespace
+{
+	TUniquePtr<FSessionPingResponder> SharedResponder;
+}
+
+void FSessionPingResponder::StartShared(int32 Port)
+{
+	SharedResponder.Reset();
+	SharedResponder = MakeUnique<FSessionPingResponder>(Port);
+	if (!SharedResponder->IsListening())
+		SharedResponder.Reset();
+}
+
+void FSessionPingResponder::StopShared()
+{
+	SharedResponder.Reset();
+}
+
+int32 FSessionPingResponder::GetSharedPort()
+{
+	return SharedResponder.IsValid() ? SharedResponder->Port : 0;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// Console commands
+
+namespace
+{
+	const int32 DefaultPingPort = 7787;
+
+	TSharedPtr<FSessionPingProber, ESPMode::ThreadSafe> TestProber;
+
+	// "AdvancedSessions.PingResponder 7787" starts answering pings, "AdvancedSessions.PingResponder stop" stops
+	FAutoConsoleCommand PingResponderCommand(
+		TEXT("AdvancedSessions.PingResponder"),
+		TEXT("Answers session ping probes on a UDP port, 7787 by default. Pass stop to stop."),
+		FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0] == TEXT("stop"))
+			{
+				FSessionPingResponder::StopShared();
+				return;
+			}
+
+			FSessionPingResponder::StartShared(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : DefaultPingPort);
+		}));
+
+	// Pings a responder, e.g. one started with AdvancedSessions.PingResponder in another process:
+	// "AdvancedSessions.PingTest 127.0.0.1:7787 64 8" sends 64 probes with at most 8 in flight
+	FAutoConsoleCommand PingTestCommand(
+		TEXT("AdvancedSessions.PingTest"),
+		TEXT("Pings a session ping responder. Takes address:port, the probe count (16) and most probes in flight (4)."),
+		FConsoleCommandWithArgsDelegate::CreateStatic([](const TArray<FString>& Args)
+		{
+			FIPv4Endpoint Endpoint;
+			if (Args.Num() == 0 || !FIPv4Endpoint::Parse(Args[0], Endpoint))
+			{
+				UE_LOG(AdvancedSessionPingLog, Warning, TEXT("Usage: AdvancedSessions.PingTest address:port [count] [max in flight]"));
+				return;
+			}
+
+			const int32 NumProbes = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 16;
+			const int32 MaxInFlight = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 4;
+
+			TArray<FIPv4Endpoint> Targets;
+			Targets.Init(Endpoint, NumProbes);
+
+			struct FPingTestStats
+			{
+				TArray<int32> Pings;
+				int32 NumTimedOut = 0;
+			};
+			TSharedRef<FPingTestStats> Stats = MakeShared<FPingTestStats>();
+
+			TestProber = MakeShared<FSessionPingProber, ESPMode::ThreadSafe>(Targets, MaxInFlight, 1.0f);
+			TestProber->OnTargetPinged.BindLambda([Stats](int32 TargetIndex, int32 PingInMs)
+			{
+				if (PingInMs < 0)
+					Stats->NumTimedOut++;
+				else
+					Stats->Pings.Add(PingInMs);
+			});
+			TestProber->OnAllPinged.BindLambda([Stats, NumProbes]()
+			{
+				int32 MinPing = MAX_int32, MaxPing = 0;
+				int64 TotalPing = 0;
+				for (int32 Ping : Stats->Pings)
+				{
+					MinPing = FMath::Min(MinPing, Ping);
+					MaxPing = FMath::Max(MaxPing, Ping);
+					TotalPing += Ping;
+				}
+
+				if (Stats->Pings.Num() > 0)
+					UE_LOG(AdvancedSessionPingLog, Display, TEXT("%d probes: min %d ms, avg %.1f ms, max %d ms, %d timed out"), NumProbes, MinPing, (double)TotalPing / Stats->Pings.Num(), MaxPing, Stats->NumTimedOut);
+				else
+					UE_LOG(AdvancedSessionPingLog, Display, TEXT("%d probes: all timed out"), NumProbes);
+			});
+
+			if (!TestProber->Start())
+				TestProber.Reset();
+		}));
+}
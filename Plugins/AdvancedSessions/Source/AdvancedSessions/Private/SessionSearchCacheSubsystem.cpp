@@ -0,0 +1,300 @@
+#include "SessionSearchCacheSubsystem.h"
+#include "FindSessionsCallbackProxyAdvanced.h"
+#include "Engine/GameInstance.h"
+
+
+//////////////////////////////////////////////////////////////////////////
+// FSessionSearchCacheKey
+
+bool FSessionSearchCacheKey::operator==(const FSessionSearchCacheKey& Other) const
+{
+	if (MaxResults != Other.MaxResults
+		|| bUseLAN != Other.bUseLAN
+		|| ServerTypeToSearch != Other.ServerTypeToSearch
+		|| bEmptyServersOnly != Other.bEmptyServersOnly
+		|| bNonEmptyServersOnly != Other.bNonEmptyServersOnly
+		|| bSecureServersOnly != Other.bSecureServersOnly
+		|| MinSlotsAvailable != Other.MinSlotsAvailable
+		|| Filters.Num() != Other.Filters.Num())
+	{
+		return false;
+	}
+
+	for (int32 i = 0; i < Filters.Num(); i++)
+	{
+		const FSessionsSearchSetting& Filter = Filters[i];
+		const FSessionsSearchSetting& OtherFilter = Other.Filters[i];
+		if (Filter.ComparisonOp != OtherFilter.ComparisonOp
+			|| Filter.PropertyKeyPair.Key != OtherFilter.PropertyKeyPair.Key
+			|| Filter.PropertyKeyPair.Data != OtherFilter.PropertyKeyPair.Data)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32 GetTypeHash(const FSessionSearchCacheKey& Key)
+{
+	uint32 Hash = GetTypeHash((uint8)Key.bUseLAN);
+	Hash = HashCombine(Hash, GetTypeHash((uint8)Key.ServerTypeToSearch));
+	Hash = HashCombine(Hash, GetTypeHash(Key.MaxResults));
+	Hash = HashCombine(Hash, GetTypeHash(Key.MinSlotsAvailable));
+	Hash = HashCombine(Hash, GetTypeHash((Key.bEmptyServersOnly ? 1 : 0) | (Key.bNonEmptyServersOnly ? 2 : 0) | (Key.bSecureServersOnly ? 4 : 0)));
+
+	for (const FSessionsSearchSetting& Filter : Key.Filters)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Filter.PropertyKeyPair.Key));
+		Hash = HashCombine(Hash, GetTypeHash((uint8)Filter.ComparisonOp));
+		Hash = HashCombine(Hash, GetTypeHash((uint8)Filter.PropertyKeyPair.Data.GetType()));
+		Hash = HashCombine(Hash, GetTypeHash(Filter.PropertyKeyPair.Data.ToString()));
+	}
+
+	return Hash;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// USessionCacheRefresh
+
+void USessionCacheRefresh::Start(USessionSearchCacheSubsystem* InCache, int32 InQueryHandle, UFindSessionsCallbackProxyAdvanced* InProxy)
+{
+	Cache = InCache;
+	QueryHandle = InQueryHandle;
+	Proxy = InProxy;
+
+	Proxy->OnSuccess.AddDynamic(this, &USessionCacheRefresh::OnSucceeded);
+	Proxy->OnFailure.AddDynamic(this, &USessionCacheRefresh::OnFailed);
+	Proxy->Activate();
+}
+
+void USessionCacheRefresh::OnSucceeded(const TArray<FBlueprintSessionResult>& Results)
+{
+	if (Cache.IsValid())
+		Cache->OnRefreshFinished(QueryHandle, true, Results);
+}
+
+void USessionCacheRefresh::OnFailed(const TArray<FBlueprintSessionResult>& Results)
+{
+	if (Cache.IsValid())
+		Cache->OnRefreshFinished(QueryHandle, false, Results);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+// USessionSearchCacheSubsystem
+
+USessionSearchCacheSubsystem::USessionSearchCacheSubsystem()
+{
+	TimeToLive = 30.0f;
+	MaxCacheKilobytes = 4096;
+	LastQueryHandle = 0;
+}
+
+int32 USessionSearchCacheSubsystem::FindSessionsCached(APlayerController* PlayerController, int32 MaxResults, bool bUseLAN, EBPServerPresenceSearchType ServerTypeToSearch, const TArray<FSessionsSearchSetting>& Filters, bool bEmptyServersOnly, bool bNonEmptyServersOnly, bool bSecureServersOnly, int MinSlotsAvailable, TArray<FBlueprintSessionResult>& CachedResults, bool& bIsStale)
+{
+	FSessionSearchCacheKey Key;
+	Key.MaxResults = MaxResults;
+	Key.bUseLAN = bUseLAN;
+	Key.ServerTypeToSearch = ServerTypeToSearch;
+	Key.Filters = Filters;
+	Key.bEmptyServersOnly = bEmptyServersOnly;
+	Key.bNonEmptyServersOnly = bNonEmptyServersOnly;
+	Key.bSecureServersOnly = bSecureServersOnly;
+	Key.MinSlotsAvailable = MinSlotsAvailable;
+
+	int32 QueryHandle = 0;
+	if (const int32* FoundHandle = QueryHandles.Find(Key))
+	{
+		QueryHandle = *FoundHandle;
+	}
+	else
+	{
+		QueryHandle = ++LastQueryHandle;
+		QueryHandles.Add(Key, QueryHandle);
+		Entries.Add(QueryHandle).Key = MoveTemp(Key);
+	}
+
+	const double Now = FPlatformTime::Seconds();
+
+	FSessionSearchCacheEntry& Entry = Entries[QueryHandle];
+	Entry.LastUsedTime = Now;
+
+	CachedResults = Entry.Results;
+	bIsStale = !Entry.bHasResults || Now - Entry.FetchTime > TimeToLive;
+
+	if (bIsStale && Entry.Refresh == nullptr)
+	{
+		UFindSessionsCallbackProxyAdvanced* Proxy = UFindSessionsCallbackProxyAdvanced::FindSessionsAdvanced(GetGameInstance(), PlayerController, MaxResults, bUseLAN, ServerTypeToSearch, Filters, bEmptyServersOnly, bNonEmptyServersOnly, bSecureServersOnly, MinSlotsAvailable);
+
+		Entry.Refresh = NewObject<USessionCacheRefresh>(this);
+		// May finish before returning, which clears Entry.Refresh again
+		Entry.Refresh->Start(this, QueryHandle, Proxy);
+	}
+
+	return QueryHandle;
+}
+
+void USessionSearchCacheSubsystem::InvalidateCache()
+{
+	for (auto& Pair : Entries)
+	{
+		Pair.Value.Results.Empty();
+		Pair.Value.NumBytes = 0;
+		Pair.Value.bHasResults = false;
+	}
+}
+
+void USessionSearchCacheSubsystem::OnRefreshFinished(int32 QueryHandle, bool bSucceeded, const TArray<FBlueprintSessionResult>& Results)
+{
+	FSessionSearchCacheEntry* Entry = Entries.Find(QueryHandle);
+	if (!Entry)
+		return;
+
+	Entry->Refresh = nullptr;
+
+	// Keep serving the old results rather than an empty list after a failed search
+	if (!bSucceeded)
+		return;
+
+	// The budget may trim the new results, the delta is taken against what was actually kept
+	const TArray<FBlueprintSessionResult> OldResults = MoveTemp(Entry->Results);
+
+	Entry->Results = Results;
+	Entry->FetchTime = FPlatformTime::Seconds();
+	Entry->bHasResults = true;
+	Entry->NumBytes = 0;
+	for (const FBlueprintSessionResult& Result : Entry->Results)
+	{
+		Entry->NumBytes += EstimateBytes(Result);
+	}
+
+	EnforceBudget(QueryHandle);
+
+	FBlueprintSessionCacheDelta Delta;
+	Delta.QueryHandle = QueryHandle;
+
+	TMap<FString, const FBlueprintSessionResult*> OldById;
+	OldById.Reserve(OldResults.Num());
+	for (const FBlueprintSessionResult& Old : OldResults)
+	{
+		OldById.Add(Old.OnlineResult.GetSessionIdStr(), &Old);
+	}
+
+	for (const FBlueprintSessionResult& New : Entries[QueryHandle].Results)
+	{
+		const FBlueprintSessionResult* Old = nullptr;
+		if (OldById.RemoveAndCopyValue(New.OnlineResult.GetSessionIdStr(), Old))
+		{
+			if (HasSessionChanged(*Old, New))
+				Delta.Changed.Add(New);
+		}
+		else
+		{
+			Delta.Added.Add(New);
+		}
+	}
+
+	for (const auto& Pair : OldById)
+	{
+		Delta.Removed.Add(*Pair.Value);
+	}
+
+	if (Delta.Added.Num() > 0 || Delta.Removed.Num() > 0 || Delta.Changed.Num() > 0)
+		OnCachedSessionsUpdated.Broadcast(Delta);
+}
+
+int64 USessionSearchCacheSubsystem::EstimateBytes(const FBlueprintSessionResult& Result)
+{
+	const FOnlineSession& Session = Result.OnlineResult.Session;
+
+	int64 Bytes = sizeof(FBlueprintSessionResult) + Session.OwningUserName.GetAllocatedSize();
+	Bytes += Session.SessionSettings.Settings.GetAllocatedSize();
+	for (const auto& Pair : Session.SessionSettings.Settings)
+	{
+		if (Pair.Value.Data.GetType() == EOnlineKeyValuePairDataType::String)
+		{
+			FString Value;
+			Pair.Value.Data.GetValue(Value);
+			Bytes += Value.GetAllocatedSize();
+		}
+	}
+	return Bytes;
+}
+
+bool USessionSearchCacheSubsystem::HasSessionChanged(const FBlueprintSessionResult& Old, const FBlueprintSessionResult& New)
+{
+	// Ping is left out, it differs on nearly every search
+	const FOnlineSession& OldSession = Old.OnlineResult.Session;
+	const FOnlineSession& NewSession = New.OnlineResult.Session;
+	if (OldSession.NumOpenPublicConnections != NewSession.NumOpenPublicConnections
+		|| OldSession.NumOpenPrivateConnections != NewSession.NumOpenPrivateConnections
+		|| OldSession.SessionSettings.NumPublicConnections != NewSession.SessionSettings.NumPublicConnections
+		|| OldSession.SessionSettings.Settings.Num() != NewSession.SessionSettings.Settings.Num())
+	{
+		return true;
+	}
+
+	for (const auto& Pair : NewSession.SessionSettings.Settings)
+	{
+		const FOnlineSessionSetting* OldSetting = OldSession.SessionSettings.Settings.Find(Pair.Key);
+		if (!OldSetting || OldSetting->Data != Pair.Value.Data)
+			return true;
+	}
+	return false;
+}
+
+void USessionSearchCacheSubsystem::EnforceBudget(int32 KeepHandle)
+{
+	const int64 MaxBytes = (int64)FMath::Max(MaxCacheKilobytes, 0) * 1024;
+
+	int64 TotalBytes = 0;
+	for (const auto& Pair : Entries)
+	{
+		TotalBytes += Pair.Value.NumBytes;
+	}
+
+	while (TotalBytes > MaxBytes)
+	{
+		// Least recently used search holding results, other than the one just stored
+		int32 OldestHandle = KeepHandle;
+		double OldestTime = TNumericLimits<double>::Max();
+		for (const auto& Pair : Entries)
+		{
+			if (Pair.Key != KeepHandle && Pair.Value.NumBytes > 0 && Pair.Value.LastUsedTime < OldestTime)
+			{
+				OldestHandle = Pair.Key;
+				OldestTime = Pair.Value.LastUsedTime;
+			}
+		}
+
+		if (OldestHandle == KeepHandle)
+			break;
+
+		FSessionSearchCacheEntry& Oldest = Entries[OldestHandle];
+		TotalBytes -= Oldest.NumBytes;
+
+		// An entry with a refresh running has to stay to receive it
+		if (Oldest.Refresh != nullptr)
+		{
+			Oldest.Results.Empty();
+			Oldest.NumBytes = 0;
+			Oldest.bHasResults = false;
+		}
+		else
+		{
+			QueryHandles.Remove(Oldest.Key);
+			Entries.Remove(OldestHandle);
+		}
+	}
+
+	// Still over with only this search left, keep as many of its results as fit
+	FSessionSearchCacheEntry& Kept = Entries[KeepHandle];
+	while (TotalBytes > MaxBytes && Kept.Results.Num() > 0)
+	{
+		const int64 LastBytes = EstimateBytes(Kept.Results.Last());
+		Kept.Results.Pop(false);
+		Kept.NumBytes -= LastBytes;
+		TotalBytes -= LastBytes;
+	}
+}
@@ -9,12 +9,17 @@
 #include "Particles/ParticleSystem.h"
 #include "Kismet/GameplayStatics.h"
 #include "UObject/ConstructorHelpers.h"
+#include "WSNetProd.h"
+#include "HeadlessProfile.h"
+#include "ProjectilePool.h"
+#include "Net/UnrealNetwork.h"
+#include "TimerManager.h"
 
 // Sets default values
 ACharacterProjectile::ACharacterProjectile()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Movement is handled by the projectile movement component, the actor itself has nothing to tick.
+	PrimaryActorTick.bCanEverTick = false;
 
 	bReplicates = true;
 
@@ -57,15 +62,37 @@ ACharacterProjectile::ACharacterProjectile()
 	ProjectileMovementComponent->bRotationFollowsVelocity = true;
 	ProjectileMovementComponent->ProjectileGravityScale = 0.0f;
 
+#if UE_SERVER
+	WSNetProdHeadless::StripCosmeticComponent(StaticMesh);
+#endif
+
 	DamageType = UDamageType::StaticClass();
 	Damage = 10.0f;
+	PooledLifetime = 5.0f;
+
+	bPoolActive = true;
+	bPooled = false;
+	LastAppliedLaunchId = 0;
+	LaunchState.LaunchId = 0;
+	LaunchState.bActive = true;
+}
+
+void ACharacterProjectile::GetLifetimeReplicatedProps(TArray <FLifetimeProperty> & OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ACharacterProjectile, LaunchState);
 }
 
 // Called when the game starts or when spawned
 void ACharacterProjectile::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	if (WSNetProdHeadless::IsHeadless(this))
+	{
+		WSNetProdHeadless::StripCosmeticComponent(StaticMesh);
+	}
 }
 
 // Called every frame
@@ -77,16 +104,141 @@ void ACharacterProjectile::Tick(float DeltaTime)
 
 void ACharacterProjectile::Destroyed()
 {
-	FVector spawnLocation = GetActorLocation();
-	UGameplayStatics::SpawnEmitterAtLocation(this, ExplosionEffect, spawnLocation, FRotator::ZeroRotator, true, EPSCPoolMethod::AutoRelease);
+	if (bPoolActive)
+	{
+		PlayExplosionEffect();
+	}
+
+	Super::Destroyed();
+}
+
+void ACharacterProjectile::PlayExplosionEffect()
+{
+#if WITH_WSNETPROD_COSMETICS
+	if (!WSNetProdHeadless::IsHeadless(this))
+	{
+		FVector spawnLocation = GetActorLocation();
+		UGameplayStatics::SpawnEmitterAtLocation(this, ExplosionEffect, spawnLocation, FRotator::ZeroRotator, true, EPSCPoolMethod::AutoRelease);
+	}
+#endif
+}
+
+void ACharacterProjectile::ActivateFromPool(const FTransform& SpawnTransform, APawn* NewInstigator)
+{
+	bPooled = true;
+	bPoolActive = true;
+	Instigator = NewInstigator;
+	SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::ResetPhysics);
+	SetInPlay(true);
+
+	LaunchState.Location = SpawnTransform.GetLocation();
+	LaunchState.Rotation = SpawnTransform.Rotator();
+	// Zero is reserved for "never launched".
+	if (++LaunchState.LaunchId == 0)
+	{
+		LaunchState.LaunchId = 1;
+	}
+	LaunchState.bActive = true;
+
+	// Wake the channel up so clients see the projectile straight away.
+	SetNetDormancy(DORM_Awake);
+	ForceNetUpdate();
+
+	// Misses never raise an impact, without this they would stay in flight and drain the pool.
+	if (PooledLifetime > 0.0f)
+	{
+		GetWorldTimerManager().SetTimer(PooledLifetimeHandle, this, &ACharacterProjectile::OnPooledLifetimeExpired, PooledLifetime, false);
+	}
+}
+
+void ACharacterProjectile::DeactivateToPool()
+{
+	bPooled = true;
+	bPoolActive = false;
+	SetInPlay(false);
+	GetWorldTimerManager().ClearTimer(PooledLifetimeHandle);
+
+	LaunchState.bActive = false;
+
+	// The final state still replicates before the channel goes dormant.
+	ForceNetUpdate();
+	SetNetDormancy(DORM_DormantAll);
+}
+
+void ACharacterProjectile::SetInPlay(bool bInPlay)
+{
+	SetActorHiddenInGame(!bInPlay);
+	SetActorEnableCollision(bInPlay);
+
+	if (bInPlay)
+	{
+		ProjectileMovementComponent->SetUpdatedComponent(SphereComponent);
+		ProjectileMovementComponent->Velocity = GetActorForwardVector() * ProjectileMovementComponent->InitialSpeed;
+		ProjectileMovementComponent->Activate(true);
+	}
+	else
+	{
+		ProjectileMovementComponent->StopMovementImmediately();
+		ProjectileMovementComponent->Deactivate();
+	}
+}
+
+void ACharacterProjectile::OnRep_LaunchState()
+{
+	// A new launch may arrive without us ever seeing the previous one end.
+	const bool bWasLaunched = LastAppliedLaunchId != 0;
+	if (bPoolActive && bWasLaunched && (!LaunchState.bActive || LaunchState.LaunchId != LastAppliedLaunchId))
+	{
+		PlayExplosionEffect();
+	}
+
+	if (LaunchState.bActive)
+	{
+		SetActorLocationAndRotation(LaunchState.Location, LaunchState.Rotation, false, nullptr, ETeleportType::ResetPhysics);
+	}
+
+	bPoolActive = LaunchState.bActive;
+	LastAppliedLaunchId = LaunchState.LaunchId;
+	SetInPlay(bPoolActive);
 }
 
 void ACharacterProjectile::OnProjectileImpact(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
+	if (!bPoolActive)
+	{
+		return;
+	}
+
 	if (OtherActor)
 	{
-		UGameplayStatics::ApplyPointDamage(OtherActor, Damage, NormalImpulse, Hit, Instigator->Controller, this, DamageType);
+		UGameplayStatics::ApplyPointDamage(OtherActor, Damage, NormalImpulse, Hit, Instigator ? Instigator->Controller : nullptr, this, DamageType);
+	}
+
+	if (bPooled)
+	{
+		PlayExplosionEffect();
+		ReturnToPool();
+	}
+	else
+	{
+		Destroy();
+	}
+}
+
+void ACharacterProjectile::OnPooledLifetimeExpired()
+{
+	if (bPoolActive)
+	{
+		ReturnToPool();
 	}
+}
 
+void ACharacterProjectile::ReturnToPool()
+{
+	if (AProjectilePool* Pool = AProjectilePool::Find(this))
+	{
+		Pool->Release(this);
+		return;
+	}
 	Destroy();
-}
\ No newline at end of file
+}
@@ -6,6 +6,25 @@
 #include "GameFramework/Actor.h"
 #include "CharacterProjectile.generated.h"
 
+/** Replicated launch state of a pooled projectile. LaunchId changes every time the projectile is reused. */
+USTRUCT()
+struct FProjectileLaunchState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		FVector_NetQuantize Location;
+
+	UPROPERTY()
+		FRotator Rotation;
+
+	UPROPERTY()
+		uint8 LaunchId;
+
+	UPROPERTY()
+		bool bActive;
+};
+
 UCLASS()
 class WSNETPROD_API ACharacterProjectile : public AActor
 {
@@ -39,12 +58,59 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Damage")
 		float Damage;
 
+	/** Seconds a pooled projectile flies before it goes back to the pool without hitting anything. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+		float PooledLifetime;
+
+	/** Property replication */
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Puts a pooled projectile back into play at SpawnTransform, flying along its forward vector. Server only. */
+	void ActivateFromPool(const FTransform& SpawnTransform, APawn* NewInstigator);
+
+	/** Takes the projectile out of play: stops movement, collision and replication until reused. Server only. */
+	void DeactivateToPool();
+
+	/** True while the projectile is in flight. Always true for projectiles that were spawned without a pool. */
+	FORCEINLINE bool IsPoolActive() const { return bPoolActive; }
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
 	virtual void Destroyed() override;
 
+	/** Plays the explosion where the projectile stopped. Skipped on dedicated servers. */
+	void PlayExplosionEffect();
+
+	/** Shows or hides the projectile and turns its movement and collision on or off. */
+	void SetInPlay(bool bInPlay);
+
+	/** Hands a pooled projectile back to its pool, destroys it if the pool is gone. */
+	void ReturnToPool();
+
+	/** Returns a pooled projectile that missed everything. */
+	void OnPooledLifetimeExpired();
+
+	UFUNCTION()
+		void OnRep_LaunchState();
+
+	/** Lets clients follow a pooled projectile being reused without replicating its movement. */
+	UPROPERTY(ReplicatedUsing = OnRep_LaunchState)
+		FProjectileLaunchState LaunchState;
+
+	/** True while the projectile is in flight. */
+	bool bPoolActive;
+
+	/** LaunchId the client last applied. */
+	uint8 LastAppliedLaunchId;
+
+	/** Set once a pool owns this projectile, from then on impacts return it to the pool instead of destroying it. */
+	bool bPooled;
+
+	/** Runs while a pooled projectile is in flight, see PooledLifetime. */
+	FTimerHandle PooledLifetimeHandle;
+
 	UFUNCTION(Category = "Projectile")
 		void OnProjectileImpact(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
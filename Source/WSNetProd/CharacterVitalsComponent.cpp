@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CharacterVitalsComponent.h"
+#include "WSNetProd.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/World.h"
+#include "Net/DataReplication.h"
+#include "HAL/IConsoleManager.h"
+#include "Net/UnrealNetwork.h"
+
+uint64 UCharacterVitalsComponent::NumComparisonsSkipped = 0;
+uint64 UCharacterVitalsComponent::NumComparisonsPerformed = 0;
+
+UCharacterVitalsComponent::UCharacterVitalsComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	// Left out of the owner's replicated components on purpose, the owner replicates it by hand.
+	bReplicates = false;
+
+	Health = 100.0f;
+	Ammo = 0;
+	ChangeSerial = 0;
+}
+
+void UCharacterVitalsComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(UCharacterVitalsComponent, Health);
+	DOREPLIFETIME_CONDITION(UCharacterVitalsComponent, Ammo, COND_OwnerOnly);
+}
+
+void UCharacterVitalsComponent::SetHealth(float NewHealth)
+{
+	if (Health == NewHealth)
+	{
+		return;
+	}
+
+	Health = NewHealth;
+	MarkDirty();
+	OnHealthChanged.Broadcast();
+}
+
+void UCharacterVitalsComponent::SetAmmo(int32 NewAmmo)
+{
+	if (Ammo == NewAmmo)
+	{
+		return;
+	}
+
+	Ammo = NewAmmo;
+	MarkDirty();
+}
+
+void UCharacterVitalsComponent::MarkDirty()
+{
+	// Defaults set during construction reach clients with the initial replication.
+	AActor* Owner = GetOwner();
+	if (GetWorld() == nullptr || Owner == nullptr || Owner->Role != ROLE_Authority)
+	{
+		return;
+	}
+
+	ChangeSerial++;
+	Owner->ForceNetUpdate();
+}
+
+bool UCharacterVitalsComponent::ReplicateIfDirty(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
+{
+	uint32* SentSerial = ChannelSentSerials.Find(Channel);
+	const bool bChangedSinceSent = SentSerial == nullptr || *SentSerial != ChangeSerial;
+
+	// A NAK'd update is only resent when the replicator is compared again, so keep comparing until it is acknowledged.
+	const TSharedRef<FObjectReplicator>* Replicator = Channel->ReplicationMap.Find(this);
+	const bool bAwaitingAck = Replicator != nullptr && !(*Replicator)->ReadyForDormancy();
+
+	if (!RepFlags->bNetInitial && !bChangedSinceSent && !bAwaitingAck)
+	{
+		NumComparisonsSkipped++;
+		return false;
+	}
+
+	if (SentSerial == nullptr)
+	{
+		// Channels close and reopen as relevancy changes, drop the ones that are gone before adding another.
+		for (auto It = ChannelSentSerials.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+		SentSerial = &ChannelSentSerials.Add(Channel);
+	}
+	*SentSerial = ChangeSerial;
+
+	NumComparisonsPerformed++;
+	return Channel->ReplicateSubobject(this, *Bunch, *RepFlags);
+}
+
+void UCharacterVitalsComponent::OnRep_Health()
+{
+	OnHealthChanged.Broadcast();
+}
+
+namespace
+{
+	void PrintVitalsReplicationStats(const TArray<FString>& Args, UWorld* World)
+	{
+		const uint64 Skipped = UCharacterVitalsComponent::NumComparisonsSkipped;
+		const uint64 Performed = UCharacterVitalsComponent::NumComparisonsPerformed;
+		const uint64 Total = Skipped + Performed;
+		UE_LOG(LogWSNetProd, Display, TEXT("Vitals replication: %llu comparisons skipped, %llu performed (%.1f%% skipped)"),
+			Skipped, Performed, Total > 0 ? 100.0 * Skipped / Total : 0.0);
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			UCharacterVitalsComponent::NumComparisonsSkipped = 0;
+			UCharacterVitalsComponent::NumComparisonsPerformed = 0;
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs VitalsReplicationStatsCommand(
+		TEXT("WSNetProd.VitalsReplicationStats"),
+		TEXT("Prints how many health/ammo replication comparisons were skipped because nothing was dirty. Pass 'reset' to clear the counters."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PrintVitalsReplicationStats));
+}
@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CharacterVitalsComponent.generated.h"
+
+class UActorChannel;
+class FOutBunch;
+struct FReplicationFlags;
+
+/**
+ * Holds a character's replicated health and ammo behind explicit setters that mark them dirty.
+ * The component is not in its owner's replicated component list, so the engine never compares it on its own.
+ * The owner replicates it from ReplicateSubobjects through ReplicateIfDirty(), which only hands it to a channel
+ * on the channel's first update, when the channel has not been sent the latest change, or while the channel still
+ * has unacknowledged vitals to resend. Idle characters skip the comparison entirely.
+ */
+UCLASS(ClassGroup = (Custom))
+class WSNETPROD_API UCharacterVitalsComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCharacterVitalsComponent();
+
+	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	FORCEINLINE float GetHealth() const { return Health; }
+
+	FORCEINLINE int32 GetAmmo() const { return Ammo; }
+
+	/** Sets health, marks it dirty and broadcasts OnHealthChanged. */
+	void SetHealth(float NewHealth);
+
+	/** Sets ammo and marks it dirty. Clients may call this to mirror a local change until the server's value arrives. */
+	void SetAmmo(int32 NewAmmo);
+
+	/**
+	 * Replicates this component through Channel if it is new to the channel, changed since the channel last sent it,
+	 * or the channel is waiting on an acknowledgement for it.
+	 * Call from the owner's ReplicateSubobjects.
+	 * @return true if anything was written.
+	 */
+	bool ReplicateIfDirty(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags);
+
+	/** Broadcast when health changes, on the server immediately and on clients when the new value arrives. */
+	FSimpleMulticastDelegate OnHealthChanged;
+
+	/** Replication attempts skipped because nothing had changed, across every instance. */
+	static uint64 NumComparisonsSkipped;
+
+	/** Replication attempts that compared and possibly sent the properties, across every instance. */
+	static uint64 NumComparisonsPerformed;
+
+private:
+	void MarkDirty();
+
+	UFUNCTION()
+		void OnRep_Health();
+
+	/** The player's current health. When reduced to 0, they are considered dead. */
+	UPROPERTY(ReplicatedUsing = OnRep_Health)
+		float Health;
+
+	/** Rounds left in the equipped weapon. Only the owner needs it. */
+	UPROPERTY(Replicated)
+		int32 Ammo;
+
+	/** Bumped on every change made with authority. */
+	uint32 ChangeSerial;
+
+	/** ChangeSerial as of the last time each channel replicated this component. */
+	TMap<TWeakObjectPtr<UActorChannel>, uint32> ChannelSentSerials;
+};
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatClock.h"
+#include "WSNetProd.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+ACombatClock::ACombatClock()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	// Ahead of everything that steps with it, their ticks see this frame's steps already run.
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	// Every machine runs its own clock.
+	bReplicates = false;
+
+	StepRate = 60.0f;
+	MaxStepsPerFrame = 8;
+
+	StepSeconds = 1.0f / StepRate;
+	AccumulatedTime = 0.0f;
+	Step = 0;
+}
+
+void ACombatClock::PostInitProperties()
+{
+	Super::PostInitProperties();
+
+	StepRate = FMath::Clamp(StepRate, 1.0f, 1000.0f);
+	StepSeconds = 1.0f / StepRate;
+}
+
+ACombatClock* ACombatClock::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (World == nullptr)
+	{
+		return nullptr;
+	}
+
+	for (TActorIterator<ACombatClock> It(World); It; ++It)
+	{
+		return *It;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<ACombatClock>(SpawnParams);
+}
+
+int32 ACombatClock::SecondsToSteps(float Seconds) const
+{
+	return FMath::Max(FMath::RoundToInt(Seconds * StepRate), 1);
+}
+
+void ACombatClock::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	AccumulatedTime += DeltaTime;
+
+	int32 NumSteps = FMath::FloorToInt(AccumulatedTime / StepSeconds);
+	if (NumSteps > MaxStepsPerFrame)
+	{
+		UE_LOG(LogWSNetProd, Verbose, TEXT("Combat clock dropped %d steps"), NumSteps - MaxStepsPerFrame);
+		AccumulatedTime -= (NumSteps - MaxStepsPerFrame) * StepSeconds;
+		NumSteps = MaxStepsPerFrame;
+	}
+
+	for (int32 i = 0; i < NumSteps; i++)
+	{
+		SCOPE_CYCLE_COUNTER(STAT_WSNetProd_CombatStep);
+		INC_DWORD_STAT(STAT_WSNetProd_CombatSteps);
+
+		AccumulatedTime -= StepSeconds;
+		Step++;
+		OnCombatStep.Broadcast(Step);
+	}
+}
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "CombatClock.generated.h"
+
+/** Called once per combat step with the step's index. Every step is exactly ACombatClock::GetStepSeconds() long. */
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnCombatStep, int64 /*Step*/);
+
+/**
+ * Fixed rate clock for combat simulation, one per world on every machine. Not replicated.
+ * Frame time is accumulated and handed out as whole steps of 1 / StepRate seconds, several per frame if needed,
+ * so weapon cooldowns, server shot processing and simulated projectiles advance the same way whatever the frame rate.
+ * Steps are numbered from one, which makes a step index enough to replay or rewind the simulation to.
+ */
+UCLASS(config = Game)
+class WSNETPROD_API ACombatClock : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	ACombatClock();
+
+	/** Returns the clock for WorldContextObject's world, spawning it on first use. */
+	static ACombatClock* Get(const UObject* WorldContextObject);
+
+	virtual void Tick(float DeltaTime) override;
+
+	/** Index of the step running now, or of the last one run between steps. Zero before the first step */
+	FORCEINLINE int64 GetStep() const { return Step; }
+
+	FORCEINLINE float GetStepSeconds() const { return StepSeconds; }
+
+	/** Simulation time at the end of Step */
+	FORCEINLINE double GetStepTime() const { return (double)Step * StepSeconds; }
+
+	/**
+	 * How far the simulation lags the frame. During a step that is how much frame time is still to be stepped through,
+	 * between steps it is the leftover below one step, which visuals can extrapolate by.
+	 */
+	FORCEINLINE float GetAccumulatedTime() const { return AccumulatedTime; }
+
+	/** Whole steps covering Seconds, at least one. Cooldowns are rounded to steps this way. */
+	int32 SecondsToSteps(float Seconds) const;
+
+	/** Broadcast once per step, in step order */
+	FOnCombatStep OnCombatStep;
+
+	/** Steps per second. Read once when the clock is created */
+	UPROPERTY(EditAnywhere, Config, Category = "Combat Clock")
+		float StepRate;
+
+	/** Most steps run in one frame. Time beyond that is dropped so a hitch cannot snowball into longer frames */
+	UPROPERTY(EditAnywhere, Config, Category = "Combat Clock")
+		int32 MaxStepsPerFrame;
+
+protected:
+	virtual void PostInitProperties() override;
+
+private:
+	float StepSeconds;
+
+	float AccumulatedTime;
+
+	int64 Step;
+};
@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatState.h"
+#include "Serialization/BitReader.h"
+#include "Serialization/BitWriter.h"
+
+namespace
+{
+	/** The last state written to a connection, which the next delta is taken against. */
+	class FCombatStateDeltaBase : public INetDeltaBaseState
+	{
+	public:
+		explicit FCombatStateDeltaBase(const FCombatState& InState)
+			: State(InState)
+		{
+		}
+
+		virtual bool IsStateEqual(INetDeltaBaseState* OtherState) override
+		{
+			return State == static_cast<FCombatStateDeltaBase*>(OtherState)->State;
+		}
+
+		FCombatState State;
+	};
+
+	void SerializeFlags(FArchive& Ar, FCombatState& State)
+	{
+		uint8 Flags = (State.bFiring ? 1 : 0) | (State.bReloading ? 2 : 0);
+		Ar.SerializeBits(&Flags, 2);
+		State.bFiring = (Flags & 1) != 0;
+		State.bReloading = (Flags & 2) != 0;
+	}
+
+	void SerializeSlot(FArchive& Ar, FCombatState& State)
+	{
+		uint32 Slot = State.EquippedSlot;
+		if (Slot > FCombatState::MaxSlot)
+		{
+			Slot = FCombatState::MaxSlot;
+		}
+		Ar.SerializeInt(Slot, FCombatState::MaxSlot + 1);
+		State.EquippedSlot = (uint8)Slot;
+	}
+}
+
+bool FCombatState::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
+{
+	SerializeFlags(Ar, *this);
+	SerializeSlot(Ar, *this);
+	Ar << AimPitch;
+	Ar << AimYaw;
+
+	bOutSuccess = !Ar.IsError();
+	return true;
+}
+
+bool FCombatState::NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms)
+{
+	if (DeltaParms.Writer != nullptr)
+	{
+		// Without a base this is the connection's first state, so everything goes.
+		const FCombatStateDeltaBase* Base = static_cast<const FCombatStateDeltaBase*>(DeltaParms.OldState);
+		if (Base != nullptr && Base->State == *this)
+		{
+			return false;
+		}
+		*DeltaParms.NewState = MakeShareable(new FCombatStateDeltaBase(*this));
+
+		FBitWriter& Writer = *DeltaParms.Writer;
+		SerializeFlags(Writer, *this);
+
+		const bool bSlotChanged = Base == nullptr || Base->State.EquippedSlot != EquippedSlot;
+		Writer.WriteBit(bSlotChanged);
+		if (bSlotChanged)
+		{
+			SerializeSlot(Writer, *this);
+		}
+
+		const bool bPitchChanged = Base == nullptr || Base->State.AimPitch != AimPitch;
+		Writer.WriteBit(bPitchChanged);
+		if (bPitchChanged)
+		{
+			Writer << AimPitch;
+		}
+
+		const bool bYawChanged = Base == nullptr || Base->State.AimYaw != AimYaw;
+		Writer.WriteBit(bYawChanged);
+		if (bYawChanged)
+		{
+			Writer << AimYaw;
+		}
+		return true;
+	}
+
+	if (DeltaParms.Reader != nullptr)
+	{
+		// Fields that did not change keep the value already received.
+		FBitReader& Reader = *DeltaParms.Reader;
+		SerializeFlags(Reader, *this);
+		if (Reader.ReadBit())
+		{
+			SerializeSlot(Reader, *this);
+		}
+		if (Reader.ReadBit())
+		{
+			Reader << AimPitch;
+		}
+		if (Reader.ReadBit())
+		{
+			Reader << AimYaw;
+		}
+		return !Reader.IsError();
+	}
+
+	// Nothing in here references objects, so there are no guids to gather or map.
+	return false;
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/NetSerialization.h"
+#include "CombatState.generated.h"
+
+/**
+ * What other players need to see of a character's weapon handling: trigger, reload, equipped slot and aim.
+ * Aim is quantized to 16 bits per axis. Replicated with a delta against the last state the connection
+ * received, so an update only carries the fields that changed: usually two flag bits and one aim axis.
+ */
+USTRUCT()
+struct FCombatState
+{
+	GENERATED_BODY()
+
+	/** Highest slot index that fits on the wire */
+	static const uint8 MaxSlot = 3;
+
+	/** Aim pitch, compressed with FRotator::CompressAxisToShort */
+	UPROPERTY()
+		uint16 AimPitch = 0;
+
+	/** Aim yaw, compressed with FRotator::CompressAxisToShort */
+	UPROPERTY()
+		uint16 AimYaw = 0;
+
+	/** Equipped weapon slot, 0 for none */
+	UPROPERTY()
+		uint8 EquippedSlot = 0;
+
+	UPROPERTY()
+		bool bFiring = false;
+
+	UPROPERTY()
+		bool bReloading = false;
+
+	void SetAim(const FRotator& Aim)
+	{
+		AimPitch = FRotator::CompressAxisToShort(Aim.Pitch);
+		AimYaw = FRotator::CompressAxisToShort(Aim.Yaw);
+	}
+
+	FRotator GetAim() const
+	{
+		return FRotator(FRotator::DecompressAxisFromShort(AimPitch), FRotator::DecompressAxisFromShort(AimYaw), 0.0f);
+	}
+
+	bool operator==(const FCombatState& Other) const
+	{
+		return AimPitch == Other.AimPitch && AimYaw == Other.AimYaw && EquippedSlot == Other.EquippedSlot
+			&& bFiring == Other.bFiring && bReloading == Other.bReloading;
+	}
+
+	bool operator!=(const FCombatState& Other) const
+	{
+		return !(*this == Other);
+	}
+
+	/** Full state in 36 bits, for RPCs. */
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+
+	/** Flags, then each other field behind a bit saying whether it changed since the connection's last state. */
+	bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParms);
+};
+
+template<>
+struct TStructOpsTypeTraits<FCombatState> : public TStructOpsTypeTraitsBase2<FCombatState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+		WithNetDeltaSerializer = true,
+		WithIdenticalViaEquality = true,
+	};
+};
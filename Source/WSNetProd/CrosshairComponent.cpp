@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CrosshairComponent.h"
+#include "WSNetProdCharacter.h"
+#include "Blueprint/UserWidget.h"
+#include "GameFramework/PlayerController.h"
+
+UCrosshairComponent::UCrosshairComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	MovingSpeedThreshold = 0.0f;
+	bMoving = false;
+	bFiring = false;
+	bWatchingMovement = false;
+}
+
+void UCrosshairComponent::OnLocallyControlled()
+{
+	AWSNetProdCharacter* Character = GetCharacter();
+	if (Character == nullptr || !Character->IsLocallyControlled())
+	{
+		return;
+	}
+
+	if (!bWatchingMovement)
+	{
+		Character->OnCharacterMovementUpdated.AddDynamic(this, &UCrosshairComponent::OnOwnerMovementUpdated);
+		bWatchingMovement = true;
+	}
+
+	SetCrosshairVisible(Character->bCrosshairVisable);
+}
+
+void UCrosshairComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	AWSNetProdCharacter* Character = GetCharacter();
+	if (Character != nullptr)
+	{
+		if (bWatchingMovement)
+		{
+			Character->OnCharacterMovementUpdated.RemoveDynamic(this, &UCrosshairComponent::OnOwnerMovementUpdated);
+			bWatchingMovement = false;
+		}
+
+		if (Character->CrosshairActiveCrosshair != nullptr)
+		{
+			Character->CrosshairActiveCrosshair->RemoveFromParent();
+		}
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UCrosshairComponent::SetActiveCrosshair(int32 Index)
+{
+	AWSNetProdCharacter* Character = GetCharacter();
+	if (Character == nullptr || !Character->CrosshairArray.IsValidIndex(Index))
+	{
+		return;
+	}
+
+	// Blueprints may have created widgets of their own, so anything but the new crosshair leaves the viewport,
+	// and the new one too while crosshairs are hidden.
+	const bool bVisible = Character->bCrosshairVisable;
+	for (int32 i = 0; i < Character->CrosshairArray.Num(); i++)
+	{
+		UUserWidget* Widget = Character->CrosshairArray[i].CrosshairsObjectWidgetArray;
+		if ((i != Index || !bVisible) && Widget != nullptr && Widget->IsInViewport())
+		{
+			Widget->RemoveFromParent();
+		}
+	}
+
+	UUserWidget* PreviousWidget = Character->CrosshairActiveCrosshair;
+	if (PreviousWidget != nullptr && (!bVisible || PreviousWidget != Character->CrosshairArray[Index].CrosshairsObjectWidgetArray))
+	{
+		PreviousWidget->RemoveFromParent();
+	}
+
+	Character->CrosshairCurrentActiveArrayIndex = Index;
+	Character->CrosshairActiveCrosshair = nullptr;
+
+	if (!bVisible)
+	{
+		return;
+	}
+
+	UUserWidget* Widget = GetOrCreateWidget(Index);
+	if (Widget != nullptr && !Widget->IsInViewport())
+	{
+		Widget->AddToViewport();
+	}
+	Character->CrosshairActiveCrosshair = Widget;
+}
+
+void UCrosshairComponent::SetCrosshairVisible(bool bVisible)
+{
+	AWSNetProdCharacter* Character = GetCharacter();
+	if (Character == nullptr)
+	{
+		return;
+	}
+
+	Character->bCrosshairVisable = bVisible;
+	SetActiveCrosshair(Character->CrosshairCurrentActiveArrayIndex);
+}
+
+void UCrosshairComponent::NotifyFiringChanged(bool bNewFiring)
+{
+	if (bFiring != bNewFiring)
+	{
+		bFiring = bNewFiring;
+		OnFiringChanged.Broadcast(bFiring);
+	}
+}
+
+void UCrosshairComponent::OnOwnerMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity)
+{
+	// Runs with every movement update anyway, this only adds a compare.
+	const bool bNewMoving = GetOwner()->GetVelocity().SizeSquared() > FMath::Square(MovingSpeedThreshold);
+	if (bMoving != bNewMoving)
+	{
+		bMoving = bNewMoving;
+		OnMovingChanged.Broadcast(bMoving);
+	}
+}
+
+UUserWidget* UCrosshairComponent::GetOrCreateWidget(int32 Index)
+{
+	AWSNetProdCharacter* Character = GetCharacter();
+	FCrosshair& Crosshair = Character->CrosshairArray[Index];
+	if (Crosshair.CrosshairsObjectWidgetArray == nullptr && Crosshair.WidgetFile != nullptr)
+	{
+		APlayerController* PlayerController = Cast<APlayerController>(Character->GetController());
+		if (PlayerController != nullptr)
+		{
+			Crosshair.CrosshairsObjectWidgetArray = CreateWidget<UUserWidget>(PlayerController, Crosshair.WidgetFile);
+		}
+	}
+	return Crosshair.CrosshairsObjectWidgetArray;
+}
+
+AWSNetProdCharacter* UCrosshairComponent::GetCharacter() const
+{
+	return Cast<AWSNetProdCharacter>(GetOwner());
+}
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "CrosshairComponent.generated.h"
+
+class AWSNetProdCharacter;
+class UUserWidget;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCrosshairStateChangedSignature, bool, bNewState);
+
+/**
+ * Shows the owning player's crosshair from the character's CrosshairArray.
+ * Widgets are only created the first time their crosshair is shown and only the active one is in the viewport.
+ * Crosshair widgets bind OnMovingChanged and OnFiringChanged instead of polling the character every frame:
+ * moving is checked where character movement already updates, firing is pushed by the character.
+ * Does nothing for characters that are not locally controlled.
+ */
+UCLASS(ClassGroup = (Custom))
+class WSNETPROD_API UCrosshairComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCrosshairComponent();
+
+	/** Shows the crosshair at Index in the owner's CrosshairArray, creating its widget if needed. */
+	UFUNCTION(BlueprintCallable, Category = "Crosshair")
+		void SetActiveCrosshair(int32 Index);
+
+	UFUNCTION(BlueprintCallable, Category = "Crosshair")
+		void SetCrosshairVisible(bool bVisible);
+
+	/** Called when the owner becomes locally controlled. Shows the active crosshair and starts watching movement. */
+	void OnLocallyControlled();
+
+	/** Called by the owner when its trigger is pressed or released. */
+	void NotifyFiringChanged(bool bNewFiring);
+
+	UFUNCTION(BlueprintPure, Category = "Crosshair")
+		FORCEINLINE bool IsMoving() const { return bMoving; }
+
+	UFUNCTION(BlueprintPure, Category = "Crosshair")
+		FORCEINLINE bool IsFiring() const { return bFiring; }
+
+	UPROPERTY(BlueprintAssignable, Category = "Crosshair")
+		FCrosshairStateChangedSignature OnMovingChanged;
+
+	UPROPERTY(BlueprintAssignable, Category = "Crosshair")
+		FCrosshairStateChangedSignature OnFiringChanged;
+
+	/** Speed above which the owner counts as moving */
+	UPROPERTY(EditDefaultsOnly, Category = "Crosshair")
+		float MovingSpeedThreshold;
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UUserWidget* GetOrCreateWidget(int32 Index);
+
+	UFUNCTION()
+		void OnOwnerMovementUpdated(float DeltaSeconds, FVector OldLocation, FVector OldVelocity);
+
+	AWSNetProdCharacter* GetCharacter() const;
+
+	bool bMoving;
+
+	bool bFiring;
+
+	bool bWatchingMovement;
+};
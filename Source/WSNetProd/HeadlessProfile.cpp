@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HeadlessProfile.h"
+#include "WSNetProd.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+
+bool WSNetProdHeadless::IsHeadless(const AActor* Actor)
+{
+#if UE_SERVER
+	return true;
+#else
+	return Actor != nullptr && Actor->GetNetMode() == NM_DedicatedServer;
+#endif
+}
+
+void WSNetProdHeadless::StripCosmeticComponent(USceneComponent* Component)
+{
+	if (Component == nullptr)
+	{
+		return;
+	}
+
+	Component->PrimaryComponentTick.bCanEverTick = false;
+	Component->SetComponentTickEnabled(false);
+	Component->bAutoActivate = false;
+	Component->SetVisibility(false);
+
+	if (USkeletalMeshComponent* SkeletalMesh = Cast<USkeletalMeshComponent>(Component))
+	{
+		// Never rendered on a server, so never pose it.
+		SkeletalMesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+		SkeletalMesh->bNoSkeletonUpdate = true;
+	}
+}
+
+namespace
+{
+	struct FActorTypeReport
+	{
+		int32 Instances = 0;
+		int32 Components = 0;
+		int32 TickingComponents = 0;
+		int32 TickingActors = 0;
+		SIZE_T Bytes = 0;
+	};
+
+	void PrintActorReport(const TArray<FString>& Args, UWorld* World)
+	{
+		if (World == nullptr)
+		{
+			return;
+		}
+
+		TMap<UClass*, FActorTypeReport> Reports;
+		for (TActorIterator<AActor> It(World); It; ++It)
+		{
+			AActor* Actor = *It;
+			FActorTypeReport& Report = Reports.FindOrAdd(Actor->GetClass());
+			Report.Instances++;
+			Report.TickingActors += Actor->IsActorTickEnabled() ? 1 : 0;
+			Report.Bytes += Actor->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+
+			for (UActorComponent* Component : Actor->GetComponents())
+			{
+				Report.Components++;
+				Report.TickingComponents += Component->IsComponentTickEnabled() ? 1 : 0;
+				Report.Bytes += Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+			}
+		}
+
+		Reports.ValueSort([](const FActorTypeReport& A, const FActorTypeReport& B) { return A.Bytes > B.Bytes; });
+
+		UE_LOG(LogWSNetProd, Display, TEXT("Actor report for %s (%s)"), *World->GetName(), World->GetNetMode() == NM_DedicatedServer ? TEXT("dedicated server") : TEXT("client"));
+		UE_LOG(LogWSNetProd, Display, TEXT("%-48s %6s %10s %10s %12s"), TEXT("Class"), TEXT("Count"), TEXT("Comps/ea"), TEXT("Ticks/ea"), TEXT("KB/ea"));
+		for (const TPair<UClass*, FActorTypeReport>& Pair : Reports)
+		{
+			const FActorTypeReport& Report = Pair.Value;
+			const float Count = (float)Report.Instances;
+			UE_LOG(LogWSNetProd, Display, TEXT("%-48s %6d %10.1f %10.1f %12.2f"),
+				*Pair.Key->GetName(),
+				Report.Instances,
+				Report.Components / Count,
+				(Report.TickingActors + Report.TickingComponents) / Count,
+				Report.Bytes / Count / 1024.0f);
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ActorReportCommand(
+		TEXT("WSNetProd.ActorReport"),
+		TEXT("Prints per actor type instance count, components, enabled tick functions and exclusive memory."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PrintActorReport));
+}
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class USceneComponent;
+
+/**
+ * Helpers for running actors on a dedicated server, where nothing is ever rendered.
+ * Cosmetic components are still constructed so blueprint overrides keep loading, but they never tick.
+ * Use the console command "WSNetProd.ActorReport" to print per actor type component, tick and memory costs.
+ */
+namespace WSNetProdHeadless
+{
+	/** True when Actor lives in a dedicated server world. */
+	WSNETPROD_API bool IsHeadless(const AActor* Actor);
+
+	/** Disables ticking, animation and visibility of a purely cosmetic component. Safe to call from a constructor. */
+	WSNETPROD_API void StripCosmeticComponent(USceneComponent* Component);
+}
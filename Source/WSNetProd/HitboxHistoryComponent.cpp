@@ -0,0 +1,179 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HitboxHistoryComponent.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+#include "WSNetProd.h"
+
+UHitboxHistoryComponent::UHitboxHistoryComponent()
+{
+	// Recording happens after movement and animation so the snapshot matches what gets replicated.
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+
+	Head = 0;
+	Count = 0;
+	bRewound = false;
+}
+
+void UHitboxHistoryComponent::SetHitboxes(const TArray<UBoxComponent*>& InHitboxes)
+{
+	check(InHitboxes.Num() <= MaxHitboxes);
+	Hitboxes = InHitboxes;
+}
+
+void UHitboxHistoryComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// History is only needed where hits are confirmed.
+	SetComponentTickEnabled(GetOwnerRole() == ROLE_Authority);
+}
+
+void UHitboxHistoryComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	RecordSnapshot(GetWorld()->GetTimeSeconds());
+}
+
+void UHitboxHistoryComponent::RecordSnapshot(float Time)
+{
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_RecordHitboxes);
+
+	SnapshotTimes[Head] = Time;
+	CapturePose(Snapshots[Head]);
+
+	Head = (Head + 1) % HistorySize;
+	Count = FMath::Min(Count + 1, HistorySize);
+}
+
+float UHitboxHistoryComponent::GetOldestTime() const
+{
+	if (Count == 0)
+	{
+		return 0.0f;
+	}
+	return SnapshotTimes[(Head - Count + HistorySize) % HistorySize];
+}
+
+void UHitboxHistoryComponent::FindSnapshots(float Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const
+{
+	// Walk from newest to oldest until we find the first snapshot at or before Time.
+	int32 Newer = (Head - 1 + HistorySize) % HistorySize;
+	int32 Older = Newer;
+	for (int32 i = 1; i < Count && SnapshotTimes[Older] > Time; i++)
+	{
+		Newer = Older;
+		Older = (Older - 1 + HistorySize) % HistorySize;
+	}
+
+	const float OlderTime = SnapshotTimes[Older];
+	const float NewerTime = SnapshotTimes[Newer];
+	if (Older == Newer || Time <= OlderTime || NewerTime <= OlderTime)
+	{
+		// Requested time is outside the buffer, clamp to the nearest snapshot.
+		OutOlder = OutNewer = Older;
+		OutAlpha = 0.0f;
+		return;
+	}
+
+	OutOlder = Older;
+	OutNewer = Newer;
+	OutAlpha = FMath::Clamp((Time - OlderTime) / (NewerTime - OlderTime), 0.0f, 1.0f);
+}
+
+bool UHitboxHistoryComponent::RewindTo(float Time)
+{
+	if (Count == 0 || bRewound)
+	{
+		return false;
+	}
+
+	int32 Older, Newer;
+	float Alpha;
+	FindSnapshots(Time, Older, Newer, Alpha);
+
+	CapturePose(SavedPose);
+	bRewound = true;
+
+	if (Older == Newer)
+	{
+		ApplyPose(Snapshots[Older]);
+		return true;
+	}
+
+	FHitboxSnapshot Blended;
+	for (int32 i = 0; i < Hitboxes.Num(); i++)
+	{
+		const FHitboxPose& A = Snapshots[Older].Poses[i];
+		const FHitboxPose& B = Snapshots[Newer].Poses[i];
+		Blended.Poses[i].Location = FMath::Lerp(A.Location, B.Location, Alpha);
+		Blended.Poses[i].Rotation = FQuat::FastLerp(A.Rotation, B.Rotation, Alpha).GetNormalized();
+	}
+	ApplyPose(Blended);
+
+	return true;
+}
+
+bool UHitboxHistoryComponent::RewindPlacementTo(float Time)
+{
+	if (Count == 0 || bRewound)
+	{
+		return false;
+	}
+
+	int32 Older, Newer;
+	float Alpha;
+	FindSnapshots(Time, Older, Newer, Alpha);
+
+	CapturePose(SavedPose);
+	bRewound = true;
+
+	const FHitboxPose& A = Snapshots[Older].Owner;
+	const FHitboxPose& B = Snapshots[Newer].Owner;
+	const FTransform PastOwner(FQuat::FastLerp(A.Rotation, B.Rotation, Alpha).GetNormalized(), FMath::Lerp(A.Location, B.Location, Alpha));
+	const FTransform CurrentOwner(SavedPose.Owner.Rotation, SavedPose.Owner.Location);
+
+	for (int32 i = 0; i < Hitboxes.Num(); i++)
+	{
+		const FTransform Current(SavedPose.Poses[i].Rotation, SavedPose.Poses[i].Location);
+		const FTransform Past = Current.GetRelativeTransform(CurrentOwner) * PastOwner;
+		Hitboxes[i]->SetWorldLocationAndRotation(Past.GetLocation(), Past.GetRotation(), false, nullptr, ETeleportType::TeleportPhysics);
+	}
+
+	return true;
+}
+
+void UHitboxHistoryComponent::Restore()
+{
+	if (bRewound)
+	{
+		ApplyPose(SavedPose);
+		bRewound = false;
+	}
+}
+
+void UHitboxHistoryComponent::CapturePose(FHitboxSnapshot& OutSnapshot) const
+{
+	for (int32 i = 0; i < Hitboxes.Num(); i++)
+	{
+		const FTransform& Transform = Hitboxes[i]->GetComponentTransform();
+		OutSnapshot.Poses[i].Location = Transform.GetLocation();
+		OutSnapshot.Poses[i].Rotation = Transform.GetRotation();
+	}
+
+	const FTransform& OwnerTransform = GetOwner()->GetActorTransform();
+	OutSnapshot.Owner.Location = OwnerTransform.GetLocation();
+	OutSnapshot.Owner.Rotation = OwnerTransform.GetRotation();
+}
+
+void UHitboxHistoryComponent::ApplyPose(const FHitboxSnapshot& Snapshot)
+{
+	for (int32 i = 0; i < Hitboxes.Num(); i++)
+	{
+		Hitboxes[i]->SetWorldLocationAndRotation(Snapshot.Poses[i].Location, Snapshot.Poses[i].Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+}
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "HitboxHistoryComponent.generated.h"
+
+class UBoxComponent;
+
+/**
+ * Server-side history of a character's hitbox transforms, used for lag compensation.
+ * A snapshot of every hitbox is recorded each server tick into a fixed-size ring buffer so
+ * that traces can be evaluated against the pose a shooting client actually saw.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class WSNETPROD_API UHitboxHistoryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UHitboxHistoryComponent();
+
+	/** Maximum number of hitboxes tracked per character. */
+	static const int32 MaxHitboxes = 8;
+
+	/** Number of snapshots kept. At a 30Hz server tick this covers roughly one second. */
+	static const int32 HistorySize = 32;
+
+	/** Sets the hitboxes to record. Must be called before BeginPlay. */
+	void SetHitboxes(const TArray<UBoxComponent*>& InHitboxes);
+
+	/** Records the current hitbox pose stamped with Time. */
+	void RecordSnapshot(float Time);
+
+	/**
+	 * Moves the hitboxes to their pose at Time, interpolating between the two nearest snapshots.
+	 * The current pose is saved and must be put back with Restore().
+	 * @return false if there is no history to rewind to.
+	 */
+	bool RewindTo(float Time);
+
+	/**
+	 * Moves the hitboxes, keeping their current pose, to where the owner stood at Time. Used for owners whose
+	 * recorded poses are approximations, after refreshing the real one. Put back with Restore().
+	 * @return false if there is no history to rewind to.
+	 */
+	bool RewindPlacementTo(float Time);
+
+	/** Puts the hitboxes back to the pose saved by the last RewindTo() or RewindPlacementTo(). */
+	void Restore();
+
+	/** Time of the oldest snapshot still held, or 0 if the buffer is empty. */
+	float GetOldestTime() const;
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	/** Location and rotation of a single hitbox. Scale never changes so it is not stored. */
+	struct FHitboxPose
+	{
+		FQuat Rotation;
+		FVector Location;
+	};
+
+	/** All hitbox poses captured on one tick, kept contiguous so a rewind touches a single block. */
+	struct FHitboxSnapshot
+	{
+		FHitboxPose Poses[MaxHitboxes];
+
+		/** Where the owner stood */
+		FHitboxPose Owner;
+	};
+
+	/**
+	 * Finds the snapshots either side of Time and how far between them it lies.
+	 * Older and Newer are the same snapshot when Time is outside the buffer.
+	 */
+	void FindSnapshots(float Time, int32& OutOlder, int32& OutNewer, float& OutAlpha) const;
+
+	void ApplyPose(const FHitboxSnapshot& Snapshot);
+	void CapturePose(FHitboxSnapshot& OutSnapshot) const;
+
+	UPROPERTY()
+		TArray<UBoxComponent*> Hitboxes;
+
+	/** Snapshot timestamps, stored apart from the poses so the search only walks this array. */
+	float SnapshotTimes[HistorySize];
+
+	FHitboxSnapshot Snapshots[HistorySize];
+
+	/** Index the next snapshot will be written to. */
+	int32 Head;
+
+	/** Number of valid snapshots in the buffer. */
+	int32 Count;
+
+	/** Pose saved by RewindTo(), put back by Restore(). */
+	FHitboxSnapshot SavedPose;
+
+	bool bRewound;
+};
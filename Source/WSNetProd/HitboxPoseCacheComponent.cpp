@@ -0,0 +1,169 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HitboxPoseCacheComponent.h"
+#include "WSNetProd.h"
+#include "HeadlessProfile.h"
+#include "Components/BoxComponent.h"
+#include "Animation/AnimInstance.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarHitboxPoseCache(
+	TEXT("WSNetProd.HitboxPoseCache"),
+	1,
+	TEXT("1 to pose server hitboxes from baked movement state poses, 0 to animate the full mesh. Read when a character begins play."),
+	ECVF_Default);
+
+UHitboxPoseCacheComponent::UHitboxPoseCacheComponent()
+{
+	// Checked after movement so the hitbox history records the pose for this frame's state.
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+
+	StateCheckInterval = 0.1f;
+	BakeSettleTime = 0.5f;
+	AppliedState = EHitboxPoseState::Idle;
+	bHasAppliedState = false;
+	bCacheActive = false;
+}
+
+void UHitboxPoseCacheComponent::SetHitboxes(USkeletalMeshComponent* InMesh, const TArray<UBoxComponent*>& InHitboxes)
+{
+	Mesh = InMesh;
+	Hitboxes = InHitboxes;
+}
+
+void UHitboxPoseCacheComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Anything that renders needs the real animation anyway.
+	bCacheActive = Mesh != nullptr
+		&& GetOwnerRole() == ROLE_Authority
+		&& WSNetProdHeadless::IsHeadless(GetOwner())
+		&& CVarHitboxPoseCache.GetValueOnGameThread() != 0;
+
+	if (!bCacheActive)
+	{
+		return;
+	}
+
+	AuthoredTransforms.Reset(Hitboxes.Num());
+	for (UBoxComponent* Hitbox : Hitboxes)
+	{
+		AuthoredTransforms.Add(Hitbox->GetRelativeTransform());
+	}
+
+	// Nothing is ever rendered here, so this stops the anim graph and keeps montages and their notifies.
+	Mesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickMontagesWhenNotRendered;
+
+	PrimaryComponentTick.TickInterval = StateCheckInterval;
+	SetComponentTickEnabled(true);
+}
+
+void UHitboxPoseCacheComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	const EHitboxPoseState State = GetCurrentState();
+	if (bHasAppliedState && State == AppliedState)
+	{
+		return;
+	}
+
+	if (BakedPoses[(int32)State].Num() == 0 && !BakeState(State))
+	{
+		// Keep the current pose and try again on the next check.
+		return;
+	}
+	ApplyState(State);
+}
+
+EHitboxPoseState UHitboxPoseCacheComponent::GetCurrentState() const
+{
+	const ACharacter* Character = Cast<ACharacter>(GetOwner());
+	const UCharacterMovementComponent* Movement = Character ? Character->GetCharacterMovement() : nullptr;
+	if (Movement == nullptr)
+	{
+		return EHitboxPoseState::Idle;
+	}
+
+	if (Movement->IsFalling())
+	{
+		return EHitboxPoseState::Falling;
+	}
+	if (Movement->IsCrouching())
+	{
+		return EHitboxPoseState::Crouching;
+	}
+	return Movement->Velocity.SizeSquared2D() > FMath::Square(10.0f) ? EHitboxPoseState::Moving : EHitboxPoseState::Idle;
+}
+
+void UHitboxPoseCacheComponent::RefreshFullPose()
+{
+	// Traces want the pose as it is now, moving the graph on would skew it in time.
+	EvaluateFullPose(0.0f);
+}
+
+void UHitboxPoseCacheComponent::EvaluateFullPose(float DeltaTime)
+{
+	if (Mesh == nullptr)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < Hitboxes.Num() && i < AuthoredTransforms.Num(); i++)
+	{
+		Hitboxes[i]->SetRelativeTransform(AuthoredTransforms[i], false, nullptr, ETeleportType::TeleportPhysics);
+	}
+
+	// Runs the anim graph synchronously. Finalizing the bones moves everything attached to them.
+	Mesh->TickAnimation(DeltaTime, false);
+	Mesh->RefreshBoneTransforms();
+}
+
+bool UHitboxPoseCacheComponent::IsMontagePlaying() const
+{
+	const UAnimInstance* AnimInstance = Mesh ? Mesh->GetAnimInstance() : nullptr;
+	return AnimInstance != nullptr && AnimInstance->IsAnyMontagePlaying();
+}
+
+bool UHitboxPoseCacheComponent::BakeState(EHitboxPoseState State)
+{
+	// A montage pose is not the state's pose, and the graph could not be settled without skipping the montage ahead.
+	if (IsMontagePlaying())
+	{
+		return false;
+	}
+
+	EvaluateFullPose(BakeSettleTime);
+
+	const FTransform& MeshTransform = Mesh->GetComponentTransform();
+	TArray<FTransform>& Pose = BakedPoses[(int32)State];
+	Pose.Reset(Hitboxes.Num());
+	for (UBoxComponent* Hitbox : Hitboxes)
+	{
+		Pose.Add(Hitbox->GetComponentTransform().GetRelativeTransform(MeshTransform));
+	}
+
+	UE_LOG(LogWSNetProd, Verbose, TEXT("%s baked hitbox pose for state %d"), *GetOwner()->GetName(), (int32)State);
+	return true;
+}
+
+void UHitboxPoseCacheComponent::ApplyState(EHitboxPoseState State)
+{
+	// Hitboxes stay attached to the mesh, so once placed they follow it without further work.
+	const FTransform& MeshTransform = Mesh->GetComponentTransform();
+	const TArray<FTransform>& Pose = BakedPoses[(int32)State];
+	for (int32 i = 0; i < Hitboxes.Num() && i < Pose.Num(); i++)
+	{
+		Hitboxes[i]->SetWorldTransform(Pose[i] * MeshTransform, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+
+	AppliedState = State;
+	bHasAppliedState = true;
+}
@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "HitboxPoseCacheComponent.generated.h"
+
+class UBoxComponent;
+class USkeletalMeshComponent;
+
+/** Coarse movement states the server keeps a baked hitbox pose for. */
+UENUM()
+enum class EHitboxPoseState : uint8
+{
+	Idle,
+	Moving,
+	Falling,
+	Crouching,
+	Num UMETA(Hidden)
+};
+
+/**
+ * Positions a character's hitboxes on a headless server without evaluating its anim graph every frame.
+ * The mesh only ticks montages; the first time the character enters a movement state outside a montage, its
+ * full pose is settled and evaluated once and the hitbox transforms relative to the mesh are baked. Afterwards the hitboxes just
+ * switch to the baked pose of the current state, checked at a low frequency. Hit confirmation refreshes the
+ * full pose of characters near a shot. Listen servers and clients keep the fully animated hitboxes.
+ */
+UCLASS(ClassGroup = (Custom))
+class WSNETPROD_API UHitboxPoseCacheComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UHitboxPoseCacheComponent();
+
+	/** Sets the mesh that drives the hitboxes and the hitboxes to pose. Must be called before BeginPlay. */
+	void SetHitboxes(USkeletalMeshComponent* InMesh, const TArray<UBoxComponent*>& InHitboxes);
+
+	/**
+	 * Evaluates the full animated pose now, for server traces that need more than a baked pose.
+	 * The anim graph is evaluated where it is, without advancing its time.
+	 */
+	void RefreshFullPose();
+
+	/** Whether the cache drives the hitboxes, false when the mesh animates normally. */
+	FORCEINLINE bool IsActive() const { return bCacheActive; }
+
+	/** Seconds between movement state checks */
+	UPROPERTY(EditDefaultsOnly, Category = "Hitbox")
+		float StateCheckInterval;
+
+	/**
+	 * Seconds the anim graph is advanced by before a pose is taken. The graph does not tick between
+	 * evaluations, so without this a new state would be captured mid blend from the previous one.
+	 */
+	UPROPERTY(EditDefaultsOnly, Category = "Hitbox")
+		float BakeSettleTime;
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+private:
+	EHitboxPoseState GetCurrentState() const;
+
+	/**
+	 * Evaluates the full pose and stores the hitboxes' transforms for State.
+	 * @return false if it has to wait, a montage would be skipped ahead or leak into the pose.
+	 */
+	bool BakeState(EHitboxPoseState State);
+
+	/**
+	 * Puts the hitboxes back on their bones and evaluates the anim graph, advanced by DeltaTime first.
+	 * Baked poses overwrite the hitboxes' relative transforms, so without this a bone refresh would offset them twice.
+	 */
+	void EvaluateFullPose(float DeltaTime);
+
+	/** Whether a montage is playing, which the anim graph must not be advanced past. */
+	bool IsMontagePlaying() const;
+
+	void ApplyState(EHitboxPoseState State);
+
+	UPROPERTY()
+		USkeletalMeshComponent* Mesh;
+
+	UPROPERTY()
+		TArray<UBoxComponent*> Hitboxes;
+
+	/** Hitbox transforms relative to their attach parents as authored, indexed like Hitboxes. */
+	TArray<FTransform> AuthoredTransforms;
+
+	/** Hitbox transforms relative to the mesh, one array per state, indexed like Hitboxes. */
+	TArray<FTransform> BakedPoses[(int32)EHitboxPoseState::Num];
+
+	EHitboxPoseState AppliedState;
+
+	bool bHasAppliedState;
+
+	bool bCacheActive;
+};
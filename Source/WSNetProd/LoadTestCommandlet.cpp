@@ -0,0 +1,205 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LoadTestCommandlet.h"
+#include "WSNetProd.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+#if PLATFORM_WINDOWS
+	const TCHAR* const ExecutableExtension = TEXT(".exe");
+#else
+	const TCHAR* const ExecutableExtension = TEXT("");
+#endif
+
+	FProcHandle LaunchProcess(const FString& Executable, const FString& Arguments)
+	{
+		UE_LOG(LogWSNetProd, Display, TEXT("Launching %s %s"), *Executable, *Arguments);
+		return FPlatformProcess::CreateProc(*Executable, *Arguments, false, true, true, nullptr, 0, nullptr, nullptr);
+	}
+
+	/** Reads a number following Key in the report, e.g. the p99 inside "frameMs": { ... }. */
+	bool ReadReportValue(const FString& Report, const TCHAR* Section, const TCHAR* Key, float& OutValue)
+	{
+		const int32 SectionStart = Report.Find(FString::Printf(TEXT("\"%s\""), Section));
+		if (SectionStart == INDEX_NONE)
+		{
+			return false;
+		}
+		const int32 KeyStart = Report.Find(FString::Printf(TEXT("\"%s\":"), Key), ESearchCase::CaseSensitive, ESearchDir::FromStart, SectionStart);
+		if (KeyStart == INDEX_NONE)
+		{
+			return false;
+		}
+		OutValue = FCString::Atof(*Report.Mid(KeyStart + FCString::Strlen(Key) + 3));
+		return true;
+	}
+
+	/** Reads a top level number from the report, e.g. "maxConnections". */
+	bool ReadReportValue(const FString& Report, const TCHAR* Key, float& OutValue)
+	{
+		const int32 KeyStart = Report.Find(FString::Printf(TEXT("\"%s\":"), Key), ESearchCase::CaseSensitive);
+		if (KeyStart == INDEX_NONE)
+		{
+			return false;
+		}
+		OutValue = FCString::Atof(*Report.Mid(KeyStart + FCString::Strlen(Key) + 3));
+		return true;
+	}
+}
+
+ULoadTestCommandlet::ULoadTestCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 ULoadTestCommandlet::Main(const FString& Params)
+{
+	int32 NumBots = 8;
+	int32 Port = 7777;
+	float Warmup = 20.0f;
+	float Duration = 60.0f;
+	float MaxFrameMsP99 = 0.0f;
+	FString Map = TEXT("/Game/Assets/StarterContent/Maps/StarterMap?game=/Script/WSNetProd.WSNetProdGameMode");
+	FString Report = TEXT("LoadTest/LoadTestReport.json");
+	FString ServerExe;
+	FString ClientExe;
+
+	FParse::Value(*Params, TEXT("Bots="), NumBots);
+	FParse::Value(*Params, TEXT("Port="), Port);
+	FParse::Value(*Params, TEXT("Warmup="), Warmup);
+	FParse::Value(*Params, TEXT("Duration="), Duration);
+	FParse::Value(*Params, TEXT("MaxFrameMsP99="), MaxFrameMsP99);
+	FParse::Value(*Params, TEXT("Map="), Map);
+	FParse::Value(*Params, TEXT("Report="), Report);
+	FParse::Value(*Params, TEXT("ServerExe="), ServerExe);
+	FParse::Value(*Params, TEXT("ClientExe="), ClientExe);
+
+	const FString ReportPath = FPaths::ConvertRelativePathToFull(FPaths::IsRelative(Report) ? FPaths::Combine(FPaths::ProjectSavedDir(), Report) : Report);
+	const FString ReadyPath = ReportPath + TEXT(".ready");
+	IFileManager::Get().Delete(*ReportPath, false, true, true);
+	IFileManager::Get().Delete(*ReadyPath, false, true, true);
+
+	const FString EditorExe = FPlatformProcess::ExecutablePath();
+	const FString ProjectFile = FString::Printf(TEXT("\"%s\""), *FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath()));
+	const FString CommonArgs = TEXT("-unattended -nosteam -nullrhi -nosound -log -stdout -FORCELOGFLUSH");
+
+	// Prefer the real server target, it is what ships.
+	FString ServerArgs = FString::Printf(TEXT("%s -port=%d %s -LoadTestRecord=\"%s\" -LoadTestWarmup=%.0f -LoadTestDuration=%.0f"),
+		*Map, Port, *CommonArgs, *ReportPath, Warmup, Duration);
+	if (ServerExe.IsEmpty())
+	{
+		const FString ServerTargetExe = FPaths::ConvertRelativePathToFull(FPaths::Combine(FPaths::ProjectDir(), TEXT("Binaries"), FPlatformProcess::GetBinariesSubdirectory(), FString(TEXT("WSNetProdServer")) + ExecutableExtension));
+		if (FPaths::FileExists(ServerTargetExe))
+		{
+			ServerExe = ServerTargetExe;
+		}
+		else
+		{
+			ServerExe = EditorExe;
+			ServerArgs = ProjectFile + TEXT(" ") + ServerArgs + TEXT(" -server");
+		}
+	}
+
+	FString ClientProjectArg;
+	if (ClientExe.IsEmpty())
+	{
+		ClientExe = EditorExe;
+		ClientProjectArg = ProjectFile + TEXT(" ");
+	}
+
+	FProcHandle ServerHandle = LaunchProcess(ServerExe, ServerArgs);
+	if (!ServerHandle.IsValid())
+	{
+		UE_LOG(LogWSNetProd, Error, TEXT("Could not launch the server."));
+		return 1;
+	}
+
+	// The server marks itself ready once its map is loaded and it is listening.
+	const double ReadyDeadline = FPlatformTime::Seconds() + 120.0;
+	while (!FPaths::FileExists(ReadyPath))
+	{
+		if (!FPlatformProcess::IsProcRunning(ServerHandle) || FPlatformTime::Seconds() > ReadyDeadline)
+		{
+			UE_LOG(LogWSNetProd, Error, TEXT("Server never became ready to accept bots."));
+			if (FPlatformProcess::IsProcRunning(ServerHandle))
+			{
+				FPlatformProcess::TerminateProc(ServerHandle, true);
+			}
+			FPlatformProcess::CloseProc(ServerHandle);
+			return 1;
+		}
+		FPlatformProcess::Sleep(0.5f);
+	}
+	IFileManager::Get().Delete(*ReadyPath, false, true, true);
+
+	TArray<FProcHandle> BotHandles;
+	for (int32 BotIndex = 0; BotIndex < NumBots; BotIndex++)
+	{
+		const FString BotArgs = FString::Printf(TEXT("%s127.0.0.1:%d -game %s -LoadTestBot=%d"), *ClientProjectArg, Port, *CommonArgs, BotIndex + 1);
+		FProcHandle BotHandle = LaunchProcess(ClientExe, BotArgs);
+		if (BotHandle.IsValid())
+		{
+			BotHandles.Add(BotHandle);
+		}
+		else
+		{
+			UE_LOG(LogWSNetProd, Warning, TEXT("Could not launch bot %d."), BotIndex + 1);
+		}
+	}
+
+	// The server exits on its own once the report is written. Anything much later than that is hung.
+	const double Deadline = FPlatformTime::Seconds() + Warmup + Duration + 120.0;
+	while (FPlatformProcess::IsProcRunning(ServerHandle) && FPlatformTime::Seconds() < Deadline)
+	{
+		FPlatformProcess::Sleep(1.0f);
+	}
+
+	if (FPlatformProcess::IsProcRunning(ServerHandle))
+	{
+		UE_LOG(LogWSNetProd, Error, TEXT("Server did not finish in time, terminating it."));
+		FPlatformProcess::TerminateProc(ServerHandle, true);
+	}
+	FPlatformProcess::CloseProc(ServerHandle);
+
+	for (FProcHandle& BotHandle : BotHandles)
+	{
+		if (FPlatformProcess::IsProcRunning(BotHandle))
+		{
+			FPlatformProcess::TerminateProc(BotHandle, true);
+		}
+		FPlatformProcess::CloseProc(BotHandle);
+	}
+
+	FString ReportContents;
+	if (!FFileHelper::LoadFileToString(ReportContents, *ReportPath))
+	{
+		UE_LOG(LogWSNetProd, Error, TEXT("No load test report at %s."), *ReportPath);
+		return 1;
+	}
+	UE_LOG(LogWSNetProd, Display, TEXT("Load test report %s:\n%s"), *ReportPath, *ReportContents);
+
+	float MaxConnections = 0.0f;
+	if (!ReadReportValue(ReportContents, TEXT("maxConnections"), MaxConnections) || (int32)MaxConnections < NumBots)
+	{
+		UE_LOG(LogWSNetProd, Error, TEXT("Only %d of %d bots connected to the server."), (int32)MaxConnections, NumBots);
+		return 1;
+	}
+
+	float FrameMsP99 = 0.0f;
+	if (MaxFrameMsP99 > 0.0f && ReadReportValue(ReportContents, TEXT("frameMs"), TEXT("p99"), FrameMsP99) && FrameMsP99 > MaxFrameMsP99)
+	{
+		UE_LOG(LogWSNetProd, Error, TEXT("Server p99 frame time %.2fms is over the %.2fms limit."), FrameMsP99, MaxFrameMsP99);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "LoadTestCommandlet.generated.h"
+
+/**
+ * Runs a local load test: starts a server and N bot clients over loopback, waits for the server to record
+ * and write its report, then shuts the bots down. Suitable for CI on a headless Linux machine.
+ *
+ *   UE4Editor-Cmd WSNetProd.uproject -run=LoadTest -Bots=16 -Duration=120
+ *
+ * Options:
+ *   -Bots=<n>				Number of bot clients (default 8)
+ *   -Map=<url>				Map and options the server loads (default the starter map with WSNetProdGameMode)
+ *   -Port=<port>			Server port (default 7777)
+ *   -Warmup=<seconds>		Time for bots to join before recording starts (default 20)
+ *   -Duration=<seconds>	Recording length (default 60)
+ *   -Report=<file>			JSON report, relative to Saved (default LoadTest/LoadTestReport.json)
+ *   -ServerExe=<path>		Server binary. Defaults to the WSNetProdServer target if built, otherwise this editor with -server
+ *   -ClientExe=<path>		Client binary. Defaults to this editor with -game
+ *   -MaxFrameMsP99=<ms>	Fail when the server's 99th percentile frame time is above this
+ *
+ * Returns 0 on success, 1 if the server never became ready, the report is missing, fewer than Bots connected
+ * or a threshold was exceeded.
+ */
+UCLASS()
+class ULoadTestCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	ULoadTestCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LoadTestSubsystem.h"
+#include "WSNetProd.h"
+#include "WSNetProdCharacter.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
+
+ULoadTestSubsystem::ULoadTestSubsystem()
+{
+	WarmupTime = 10.0f;
+	Duration = 60.0f;
+	BotMoveDirection = FVector::ForwardVector;
+	BotYawRate = 0.0f;
+	NextDirectionChangeTime = 0.0f;
+	NextTriggerChangeTime = 0.0f;
+	NextReloadTime = 0.0f;
+	BotTime = 0.0f;
+	bBotFiring = false;
+}
+
+void ULoadTestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const TCHAR* CommandLine = FCommandLine::Get();
+
+	int32 BotSeed = 0;
+	if (FParse::Value(CommandLine, TEXT("LoadTestBot="), BotSeed) || FParse::Param(CommandLine, TEXT("LoadTestBot")))
+	{
+		BotRandom.Initialize(BotSeed);
+		TickHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ULoadTestSubsystem::TickBot));
+		UE_LOG(LogWSNetProd, Display, TEXT("Running as load test bot %d."), BotSeed);
+	}
+
+	if (FParse::Value(CommandLine, TEXT("LoadTestRecord="), ReportPath))
+	{
+		FParse::Value(CommandLine, TEXT("LoadTestWarmup="), WarmupTime);
+		FParse::Value(CommandLine, TEXT("LoadTestDuration="), Duration);
+		if (FPaths::IsRelative(ReportPath))
+		{
+			ReportPath = FPaths::Combine(FPaths::ProjectSavedDir(), ReportPath);
+		}
+		PostLoadMapHandle = FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &ULoadTestSubsystem::OnPostLoadMap);
+	}
+}
+
+void ULoadTestSubsystem::Deinitialize()
+{
+	FTicker::GetCoreTicker().RemoveTicker(TickHandle);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.Remove(PostLoadMapHandle);
+
+	// A server shut down early still leaves a report behind.
+	if (Recorder.IsValid() && Recorder->IsTickable())
+	{
+		Recorder->WriteReport();
+	}
+	Recorder.Reset();
+
+	Super::Deinitialize();
+}
+
+void ULoadTestSubsystem::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (Recorder.IsValid() || LoadedWorld == nullptr || LoadedWorld->GetNetMode() == NM_Client || LoadedWorld->GetNetMode() == NM_Standalone)
+	{
+		return;
+	}
+
+	Recorder = MakeUnique<TestServer>(LoadedWorld, ReportPath, WarmupTime, Duration);
+
+	// Tells ULoadTestCommandlet the bots can connect.
+	FFileHelper::SaveStringToFile(LoadedWorld->GetMapName(), *(ReportPath + TEXT(".ready")));
+}
+
+bool ULoadTestSubsystem::TickBot(float DeltaTime)
+{
+	APlayerController* PlayerController = GetGameInstance()->GetFirstLocalPlayerController();
+	AWSNetProdCharacter* Character = PlayerController ? Cast<AWSNetProdCharacter>(PlayerController->GetPawn()) : nullptr;
+	if (Character == nullptr)
+	{
+		return true;
+	}
+
+	BotTime += DeltaTime;
+
+	// Wander: a new heading and turn rate every few seconds, with the odd jump.
+	if (BotTime >= NextDirectionChangeTime)
+	{
+		const float Heading = BotRandom.FRandRange(0.0f, 2.0f * PI);
+		BotMoveDirection = FVector(FMath::Cos(Heading), FMath::Sin(Heading), 0.0f);
+		BotYawRate = BotRandom.FRandRange(-90.0f, 90.0f);
+		NextDirectionChangeTime = BotTime + BotRandom.FRandRange(1.0f, 3.0f);
+
+		if (BotRandom.FRand() < 0.2f)
+		{
+			Character->Jump();
+		}
+	}
+
+	Character->AddMovementInput(BotMoveDirection, 1.0f);
+	PlayerController->SetControlRotation(PlayerController->GetControlRotation() + FRotator(0.0f, BotYawRate * DeltaTime, 0.0f));
+
+	// Fire in bursts with pauses in between.
+	if (BotTime >= NextTriggerChangeTime)
+	{
+		bBotFiring = !bBotFiring;
+		if (bBotFiring)
+		{
+			Character->StartFiring();
+			NextTriggerChangeTime = BotTime + BotRandom.FRandRange(0.5f, 2.0f);
+		}
+		else
+		{
+			Character->StopFiring();
+			NextTriggerChangeTime = BotTime + BotRandom.FRandRange(0.5f, 1.5f);
+		}
+	}
+
+	// Reload part way through a magazine now and then, on top of the automatic reload when empty.
+	if (BotTime >= NextReloadTime)
+	{
+		if (NextReloadTime > 0.0f)
+		{
+			Character->ReloadGun(Character);
+		}
+		NextReloadTime = BotTime + BotRandom.FRandRange(8.0f, 15.0f);
+	}
+
+	return true;
+}
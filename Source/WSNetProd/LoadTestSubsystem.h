@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Containers/Ticker.h"
+#include "TestServer.h"
+#include "LoadTestSubsystem.generated.h"
+
+class UWorld;
+
+/**
+ * Per process side of the load test harness, see ULoadTestCommandlet.
+ *  -LoadTestBot[=<seed>] turns the local player into a bot that runs a scripted pattern of movement,
+ *   firing bursts and reloads, so any number of headless clients can load a server.
+ *  -LoadTestRecord=<report> makes a server record its performance with TestServer and exit when done.
+ *   -LoadTestWarmup=<seconds> and -LoadTestDuration=<seconds> control when recording starts and for how long.
+ * Does nothing without those switches.
+ */
+UCLASS()
+class WSNETPROD_API ULoadTestSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	ULoadTestSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+private:
+	bool TickBot(float DeltaTime);
+
+	/** Starts the recorder once the server has loaded its map, and writes <report>.ready for the commandlet. */
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	FDelegateHandle TickHandle;
+	FDelegateHandle PostLoadMapHandle;
+
+	TUniquePtr<TestServer> Recorder;
+
+	FString ReportPath;
+	float WarmupTime;
+	float Duration;
+
+	FRandomStream BotRandom;
+
+	/** Scripted bot state */
+	FVector BotMoveDirection;
+	float BotYawRate;
+	float NextDirectionChangeTime;
+	float NextTriggerChangeTime;
+	float NextReloadTime;
+	float BotTime;
+	bool bBotFiring;
+};
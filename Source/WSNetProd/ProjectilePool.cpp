@@ -0,0 +1,163 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectilePool.h"
+#include "WSNetProd.h"
+#include "CharacterProjectile.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+AProjectilePool::AProjectilePool()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	// The pooled projectiles replicate themselves, the pool is server bookkeeping only.
+	bReplicates = false;
+
+	ProjectileClass = ACharacterProjectile::StaticClass();
+	InitialPoolSize = 32;
+	MaxFreeProjectiles = 256;
+}
+
+AProjectilePool* AProjectilePool::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (World == nullptr || World->IsNetMode(NM_Client))
+	{
+		return nullptr;
+	}
+
+	if (AProjectilePool* Pool = Find(World))
+	{
+		return Pool;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<AProjectilePool>(SpawnParams);
+}
+
+AProjectilePool* AProjectilePool::Find(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (World == nullptr)
+	{
+		return nullptr;
+	}
+
+	for (TActorIterator<AProjectilePool> It(World); It; ++It)
+	{
+		return *It;
+	}
+	return nullptr;
+}
+
+ACharacterProjectile* AProjectilePool::SpawnPooledProjectile(UObject* WorldContextObject, const FTransform& SpawnTransform, APawn* Instigator)
+{
+	AProjectilePool* Pool = Get(WorldContextObject);
+	return Pool ? Pool->Acquire(SpawnTransform, Instigator) : nullptr;
+}
+
+void AProjectilePool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	FreeProjectiles.Reserve(FMath::Max(InitialPoolSize, 0));
+	for (int32 i = 0; i < InitialPoolSize; i++)
+	{
+		if (ACharacterProjectile* Projectile = SpawnProjectile())
+		{
+			Projectile->DeactivateToPool();
+			FreeProjectiles.Add(Projectile);
+		}
+	}
+	Stats.NumFree = FreeProjectiles.Num();
+}
+
+ACharacterProjectile* AProjectilePool::SpawnProjectile()
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Owner = this;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return GetWorld()->SpawnActor<ACharacterProjectile>(ProjectileClass, FTransform::Identity, SpawnParams);
+}
+
+ACharacterProjectile* AProjectilePool::Acquire(const FTransform& SpawnTransform, APawn* Instigator)
+{
+	ACharacterProjectile* Projectile = nullptr;
+	while (Projectile == nullptr && FreeProjectiles.Num() > 0)
+	{
+		Projectile = FreeProjectiles.Pop(false);
+		if (!IsValid(Projectile))
+		{
+			Projectile = nullptr;
+		}
+	}
+
+	if (Projectile != nullptr)
+	{
+		Stats.Hits++;
+	}
+	else
+	{
+		Stats.Misses++;
+		Projectile = SpawnProjectile();
+		if (Projectile == nullptr)
+		{
+			return nullptr;
+		}
+	}
+
+	Projectile->ActivateFromPool(SpawnTransform, Instigator);
+
+	Stats.NumActive++;
+	Stats.NumFree = FreeProjectiles.Num();
+	Stats.HighWaterMark = FMath::Max(Stats.HighWaterMark, Stats.NumActive);
+	return Projectile;
+}
+
+void AProjectilePool::Release(ACharacterProjectile* Projectile)
+{
+	if (Projectile == nullptr || !Projectile->IsPoolActive())
+	{
+		return;
+	}
+
+	Stats.NumActive = FMath::Max(Stats.NumActive - 1, 0);
+
+	Projectile->DeactivateToPool();
+
+	if (FreeProjectiles.Num() >= MaxFreeProjectiles)
+	{
+		Projectile->Destroy();
+		return;
+	}
+
+	FreeProjectiles.Add(Projectile);
+	Stats.NumFree = FreeProjectiles.Num();
+}
+
+namespace
+{
+	void PrintProjectilePoolStats(const TArray<FString>& Args, UWorld* World)
+	{
+		// Only looks, a pool made here would spawn its projectiles for nothing.
+		AProjectilePool* Pool = AProjectilePool::Find(World);
+		if (Pool == nullptr)
+		{
+			UE_LOG(LogWSNetProd, Display, TEXT("No projectile pool in this world (pools only exist on the server, once a pooled projectile was fired)."));
+			return;
+		}
+
+		const FProjectilePoolStats& Stats = Pool->GetStats();
+		UE_LOG(LogWSNetProd, Display, TEXT("Projectile pool: %d hits, %d misses, high water mark %d, %d active, %d free"),
+			Stats.Hits, Stats.Misses, Stats.HighWaterMark, Stats.NumActive, Stats.NumFree);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ProjectilePoolStatsCommand(
+		TEXT("WSNetProd.ProjectilePoolStats"),
+		TEXT("Prints projectile pool hits, misses and high water mark."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PrintProjectilePoolStats));
+}
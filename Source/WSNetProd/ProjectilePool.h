@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "ProjectilePool.generated.h"
+
+class ACharacterProjectile;
+
+/** Usage counters for a projectile pool. */
+USTRUCT(BlueprintType)
+struct FProjectilePoolStats
+{
+	GENERATED_BODY()
+
+	/** Acquires served from the free list */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Projectile Pool")
+		int32 Hits = 0;
+
+	/** Acquires that had to spawn a new projectile */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Projectile Pool")
+		int32 Misses = 0;
+
+	/** Most projectiles in flight at the same time */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Projectile Pool")
+		int32 HighWaterMark = 0;
+
+	/** Projectiles currently in flight */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Projectile Pool")
+		int32 NumActive = 0;
+
+	/** Projectiles waiting in the free list */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Projectile Pool")
+		int32 NumFree = 0;
+};
+
+/**
+ * Server-side pool of ACharacterProjectile actors, one per world.
+ * Projectiles are recycled instead of being spawned and destroyed per shot, which avoids actor spawn
+ * hitches and garbage collection spikes under sustained fire. Weapons that fire actor projectiles should
+ * spawn them through SpawnPooledProjectile; the pool and its initial projectiles are only created on the first call.
+ */
+UCLASS(config = Game)
+class WSNETPROD_API AProjectilePool : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AProjectilePool();
+
+	/** Returns the pool for WorldContextObject's world, spawning it on first use. Null on clients. */
+	static AProjectilePool* Get(const UObject* WorldContextObject);
+
+	/** Returns the pool for WorldContextObject's world if one was created, never spawns it. */
+	static AProjectilePool* Find(const UObject* WorldContextObject);
+
+	/** Fires a pooled projectile from SpawnTransform. Server only. */
+	UFUNCTION(BlueprintCallable, Category = "Projectile", meta = (WorldContext = "WorldContextObject"))
+		static ACharacterProjectile* SpawnPooledProjectile(UObject* WorldContextObject, const FTransform& SpawnTransform, APawn* Instigator);
+
+	/** Takes a projectile from the free list, or spawns one if the list is empty, and puts it into play. */
+	ACharacterProjectile* Acquire(const FTransform& SpawnTransform, APawn* Instigator);
+
+	/** Takes a projectile out of play and returns it to the free list, destroying it if the pool is full. */
+	void Release(ACharacterProjectile* Projectile);
+
+	UFUNCTION(BlueprintPure, Category = "Projectile")
+		FORCEINLINE FProjectilePoolStats GetStats() const { return Stats; }
+
+	/** Projectile class the pool hands out */
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Pool")
+		TSubclassOf<ACharacterProjectile> ProjectileClass;
+
+	/** Projectiles spawned when the pool is created, on the first pooled shot */
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Pool")
+		int32 InitialPoolSize;
+
+	/** Released projectiles beyond this many free ones are destroyed instead of kept */
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Pool")
+		int32 MaxFreeProjectiles;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	ACharacterProjectile* SpawnProjectile();
+
+	UPROPERTY()
+		TArray<ACharacterProjectile*> FreeProjectiles;
+
+	FProjectilePoolStats Stats;
+};
@@ -0,0 +1,318 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileSimulation.h"
+#include "WSNetProd.h"
+#include "CombatClock.h"
+#include "HeadlessProfile.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/DamageType.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/Pawn.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystem.h"
+#include "UObject/ConstructorHelpers.h"
+
+AProjectileSimulation::AProjectileSimulation()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+	bReplicates = true;
+	bAlwaysRelevant = true;
+
+	// Nothing is property replicated, the simulation only talks through its multicasts.
+	// Unreliable multicasts wait for the actor's next update, so Tick forces one whenever it sends any.
+	NetUpdateFrequency = 1.0f;
+
+	ProjectileInstances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("ProjectileInstances"));
+	ProjectileInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	ProjectileInstances->SetGenerateOverlapEvents(false);
+	ProjectileInstances->CastShadow = false;
+	RootComponent = ProjectileInstances;
+
+	static ConstructorHelpers::FObjectFinder<UStaticMesh> DefaultMesh(TEXT("/Game/Assets/StarterContent/Shapes/Shape_Sphere.Shape_Sphere"));
+	if (DefaultMesh.Succeeded())
+	{
+		ProjectileInstances->SetStaticMesh(DefaultMesh.Object);
+	}
+
+#if UE_SERVER
+	WSNetProdHeadless::StripCosmeticComponent(ProjectileInstances);
+#endif
+
+	Speed = 10000.0f;
+	Radius = 0.0f;
+	GravityScale = 0.0f;
+	Lifetime = 2.0f;
+	Damage = 10.0f;
+	DamageType = UDamageType::StaticClass();
+	NextId = 1;
+}
+
+AProjectileSimulation* AProjectileSimulation::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+	if (World == nullptr)
+	{
+		return nullptr;
+	}
+
+	for (TActorIterator<AProjectileSimulation> It(World); It; ++It)
+	{
+		return *It;
+	}
+
+	if (World->IsNetMode(NM_Client))
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return World->SpawnActor<AProjectileSimulation>(SpawnParams);
+}
+
+void AProjectileSimulation::FireSimulatedProjectile(UObject* WorldContextObject, FVector Start, FVector Direction, APawn* Instigator)
+{
+	if (AProjectileSimulation* Simulation = Get(WorldContextObject))
+	{
+		Simulation->Fire(Start, Direction, Instigator);
+	}
+}
+
+void AProjectileSimulation::Fire(const FVector& Start, const FVector& Direction, APawn* InstigatorPawn)
+{
+	if (Role != ROLE_Authority)
+	{
+		return;
+	}
+
+	const FVector UnitDirection = Direction.GetSafeNormal();
+	const uint32 Id = NextId++;
+	AddProjectile(Id, Start, UnitDirection, InstigatorPawn);
+
+	FSimulatedProjectileSpawn Spawn;
+	Spawn.Start = Start;
+	Spawn.Direction = UnitDirection;
+	Spawn.ServerTime = GetServerWorldTime();
+	Spawn.Id = Id;
+	PendingSpawns.Add(Spawn);
+}
+
+int32 AProjectileSimulation::AddProjectile(uint32 Id, const FVector& Start, const FVector& Direction, APawn* InstigatorPawn)
+{
+	Positions.Add(Start);
+	Velocities.Add(Direction * Speed);
+	TimeRemaining.Add(Lifetime);
+	Ids.Add(Id);
+	return Instigators.Add(InstigatorPawn);
+}
+
+void AProjectileSimulation::RemoveProjectile(int32 Index)
+{
+	Positions.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	TimeRemaining.RemoveAtSwap(Index, 1, false);
+	Ids.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+}
+
+void AProjectileSimulation::BeginPlay()
+{
+	Super::BeginPlay();
+
+	CombatClock = ACombatClock::Get(this);
+	if (CombatClock != nullptr)
+	{
+		CombatStepHandle = CombatClock->OnCombatStep.AddUObject(this, &AProjectileSimulation::StepProjectiles);
+
+		// Sends and draws what this frame's steps did.
+		AddTickPrerequisiteActor(CombatClock);
+	}
+}
+
+void AProjectileSimulation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (CombatClock != nullptr)
+	{
+		CombatClock->OnCombatStep.Remove(CombatStepHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AProjectileSimulation::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Role == ROLE_Authority && (PendingSpawns.Num() > 0 || PendingImpacts.Num() > 0))
+	{
+		if (PendingSpawns.Num() > 0)
+		{
+			MulticastProjectilesSpawned(PendingSpawns);
+			PendingSpawns.Reset();
+		}
+		if (PendingImpacts.Num() > 0)
+		{
+			MulticastProjectilesImpacted(PendingImpacts);
+			PendingImpacts.Reset();
+		}
+
+		// Otherwise they would sit in the channel for up to a second at this update rate.
+		ForceNetUpdate();
+	}
+
+	UpdateInstances();
+}
+
+void AProjectileSimulation::StepProjectiles(int64 Step)
+{
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_StepProjectiles);
+
+	const float StepSeconds = CombatClock->GetStepSeconds();
+	UWorld* World = GetWorld();
+	const FVector Gravity(0.0f, 0.0f, World->GetGravityZ() * GravityScale);
+	const bool bUseSweep = Radius > 0.0f;
+	const FCollisionShape Shape = FCollisionShape::MakeSphere(Radius);
+
+	// Walk backwards so removing with a swap never skips a projectile.
+	for (int32 i = Ids.Num() - 1; i >= 0; i--)
+	{
+		TimeRemaining[i] -= StepSeconds;
+		if (TimeRemaining[i] <= 0.0f)
+		{
+			RemoveProjectile(i);
+			continue;
+		}
+
+		const FVector Start = Positions[i];
+		FVector End;
+		Integrate(i, Gravity, StepSeconds, End);
+
+		FCollisionQueryParams Params(SCENE_QUERY_STAT(SimulatedProjectile), false, Instigators[i].Get());
+		FHitResult Hit;
+		const bool bHit = bUseSweep
+			? World->SweepSingleByChannel(Hit, Start, End, FQuat::Identity, ECC_Hitbox, Shape, Params)
+			: World->LineTraceSingleByChannel(Hit, Start, End, ECC_Hitbox, Params);
+
+		if (bHit)
+		{
+			OnImpact(i, Hit);
+			RemoveProjectile(i);
+			continue;
+		}
+
+		Positions[i] = End;
+	}
+}
+
+void AProjectileSimulation::OnImpact(int32 Index, const FHitResult& Hit)
+{
+	// Clients wait for the server's impact event, their own sweep only stops the visual.
+	if (Role != ROLE_Authority)
+	{
+		return;
+	}
+
+	if (AActor* HitActor = Hit.GetActor())
+	{
+		APawn* InstigatorPawn = Instigators[Index].Get();
+		UGameplayStatics::ApplyPointDamage(HitActor, Damage, Velocities[Index].GetSafeNormal(), Hit, InstigatorPawn ? InstigatorPawn->GetController() : nullptr, this, DamageType);
+	}
+
+	FSimulatedProjectileImpact Impact;
+	Impact.Location = Hit.ImpactPoint;
+	Impact.Id = Ids[Index];
+	PendingImpacts.Add(Impact);
+}
+
+void AProjectileSimulation::MulticastProjectilesSpawned_Implementation(const TArray<FSimulatedProjectileSpawn>& Spawns)
+{
+	if (Role == ROLE_Authority)
+	{
+		return;
+	}
+
+	if (CombatClock == nullptr)
+	{
+		return;
+	}
+
+	const float Now = GetServerWorldTime();
+	const float StepSeconds = CombatClock->GetStepSeconds();
+	const FVector Gravity(0.0f, 0.0f, GetWorld()->GetGravityZ() * GravityScale);
+	for (const FSimulatedProjectileSpawn& Spawn : Spawns)
+	{
+		const int32 Index = AddProjectile(Spawn.Id, Spawn.Start, Spawn.Direction, nullptr);
+
+		// Catch up with where the projectile is on the server by now, stepping the way the server did.
+		// Only the server's sweeps count, so none are done here.
+		const int32 ElapsedSteps = FMath::Min(FMath::RoundToInt(FMath::Max(Now - Spawn.ServerTime, 0.0f) / StepSeconds), CombatClock->SecondsToSteps(Lifetime));
+		for (int32 i = 0; i < ElapsedSteps; i++)
+		{
+			Integrate(Index, Gravity, StepSeconds, Positions[Index]);
+		}
+		TimeRemaining[Index] -= ElapsedSteps * StepSeconds;
+	}
+}
+
+void AProjectileSimulation::MulticastProjectilesImpacted_Implementation(const TArray<FSimulatedProjectileImpact>& Impacts)
+{
+	if (Role == ROLE_Authority)
+	{
+		return;
+	}
+
+	for (const FSimulatedProjectileImpact& Impact : Impacts)
+	{
+		const int32 Index = Ids.Find(Impact.Id);
+		if (Index != INDEX_NONE)
+		{
+			RemoveProjectile(Index);
+		}
+
+#if WITH_WSNETPROD_COSMETICS
+		UGameplayStatics::SpawnEmitterAtLocation(this, ImpactEffect, Impact.Location, FRotator::ZeroRotator, true, EPSCPoolMethod::AutoRelease);
+#endif
+	}
+}
+
+void AProjectileSimulation::UpdateInstances()
+{
+#if WITH_WSNETPROD_COSMETICS
+	if (WSNetProdHeadless::IsHeadless(this))
+	{
+		return;
+	}
+
+	// Instances map one to one onto the arrays. Only trailing instances are ever added or removed,
+	// which keeps removal constant time.
+	while (ProjectileInstances->GetInstanceCount() > Positions.Num())
+	{
+		ProjectileInstances->RemoveInstance(ProjectileInstances->GetInstanceCount() - 1);
+	}
+	while (ProjectileInstances->GetInstanceCount() < Positions.Num())
+	{
+		ProjectileInstances->AddInstanceWorldSpace(FTransform::Identity);
+	}
+
+	// Positions are as of the last step, carry them on by the time since so flight looks smooth at any frame rate.
+	const float Extrapolation = CombatClock ? CombatClock->GetAccumulatedTime() : 0.0f;
+	const FVector Scale(0.05f);
+	for (int32 i = 0; i < Positions.Num(); i++)
+	{
+		ProjectileInstances->UpdateInstanceTransform(i, FTransform(FQuat::Identity, Positions[i] + Velocities[i] * Extrapolation, Scale), true, false, true);
+	}
+	ProjectileInstances->MarkRenderStateDirty();
+#endif
+}
+
+float AProjectileSimulation::GetServerWorldTime() const
+{
+	AGameStateBase* GameState = GetWorld()->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+}
@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "ProjectileSimulation.generated.h"
+
+class UInstancedStaticMeshComponent;
+
+/** Replicated spawn of a simulated projectile. Clients re-simulate the flight from it. */
+USTRUCT()
+struct FSimulatedProjectileSpawn
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		FVector_NetQuantize Start;
+
+	UPROPERTY()
+		FVector_NetQuantizeNormal Direction;
+
+	/** Server world time the projectile was fired at */
+	UPROPERTY()
+		float ServerTime;
+
+	UPROPERTY()
+		uint32 Id;
+};
+
+/** Replicated impact of a simulated projectile. */
+USTRUCT()
+struct FSimulatedProjectileImpact
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		FVector_NetQuantize Location;
+
+	UPROPERTY()
+		uint32 Id;
+};
+
+/**
+ * Simulates high volume projectiles as plain data instead of one actor each.
+ * Projectiles live in contiguous arrays (one per field) and are stepped in a single batch with one sweep each.
+ * Only spawn and impact events replicate; clients re-simulate the flight for visuals and never apply damage.
+ * Flight advances in ACombatClock steps, so a projectile follows the same path on the server and every client.
+ * One instance exists per world, spawned by the server and replicated to every client.
+ */
+UCLASS(config = Game)
+class WSNETPROD_API AProjectileSimulation : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AProjectileSimulation();
+
+	/** Returns the simulation for WorldContextObject's world. Spawns it on the server, may be null on clients until replicated. */
+	static AProjectileSimulation* Get(const UObject* WorldContextObject);
+
+	/** Fires a simulated projectile. Server only. */
+	UFUNCTION(BlueprintCallable, Category = "Projectile", meta = (WorldContext = "WorldContextObject"))
+		static void FireSimulatedProjectile(UObject* WorldContextObject, FVector Start, FVector Direction, APawn* Instigator);
+
+	void Fire(const FVector& Start, const FVector& Direction, APawn* InstigatorPawn);
+
+	virtual void Tick(float DeltaTime) override;
+
+	UFUNCTION(BlueprintPure, Category = "Projectile")
+		FORCEINLINE int32 GetNumProjectiles() const { return Ids.Num(); }
+
+	/** Speed of every simulated projectile, in units per second */
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Simulation")
+		float Speed;
+
+	/** Collision radius. Zero uses a line trace instead of a sphere sweep */
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Simulation")
+		float Radius;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Simulation")
+		float GravityScale;
+
+	/** Seconds before an unimpacted projectile is removed */
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Simulation")
+		float Lifetime;
+
+	UPROPERTY(EditAnywhere, Config, Category = "Projectile Simulation")
+		float Damage;
+
+	UPROPERTY(EditAnywhere, Category = "Projectile Simulation")
+		TSubclassOf<class UDamageType> DamageType;
+
+	/** Played where a projectile impacts. Clients only */
+	UPROPERTY(EditAnywhere, Category = "Projectile Simulation")
+		class UParticleSystem* ImpactEffect;
+
+	/** Renders every in-flight projectile as one instance. Clients only */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Components")
+		UInstancedStaticMeshComponent* ProjectileInstances;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UFUNCTION(NetMulticast, Unreliable)
+		void MulticastProjectilesSpawned(const TArray<FSimulatedProjectileSpawn>& Spawns);
+
+	UFUNCTION(NetMulticast, Unreliable)
+		void MulticastProjectilesImpacted(const TArray<FSimulatedProjectileImpact>& Impacts);
+
+private:
+	/** Adds a projectile to the arrays and returns its index. */
+	int32 AddProjectile(uint32 Id, const FVector& Start, const FVector& Direction, APawn* InstigatorPawn);
+
+	void RemoveProjectile(int32 Index);
+
+	/** Moves every projectile forward by one combat step, sweeping for hits. */
+	void StepProjectiles(int64 Step);
+
+	/** Moves one projectile forward by one step, the only place flight is integrated. */
+	FORCEINLINE void Integrate(int32 Index, const FVector& Gravity, float StepSeconds, FVector& OutEnd)
+	{
+		Velocities[Index] += Gravity * StepSeconds;
+		OutEnd = Positions[Index] + Velocities[Index] * StepSeconds;
+	}
+
+	void OnImpact(int32 Index, const FHitResult& Hit);
+
+	void UpdateInstances();
+
+	float GetServerWorldTime() const;
+
+	/** Per projectile data, one array per field, all indexed together. */
+	TArray<FVector> Positions;
+	TArray<FVector> Velocities;
+	TArray<float> TimeRemaining;
+	TArray<uint32> Ids;
+	TArray<TWeakObjectPtr<APawn>> Instigators;
+
+	/** Events gathered this frame, sent in one batch each */
+	TArray<FSimulatedProjectileSpawn> PendingSpawns;
+	TArray<FSimulatedProjectileImpact> PendingImpacts;
+
+	uint32 NextId;
+
+	UPROPERTY()
+		class ACombatClock* CombatClock;
+
+	FDelegateHandle CombatStepHandle;
+};
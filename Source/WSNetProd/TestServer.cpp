@@ -2,11 +2,182 @@
 
 
 #include "TestServer.h"
+#include "WSNetProd.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/UObjectGlobals.h"
 
-TestServer::TestServer()
+namespace
 {
+	/** Value at fraction Percentile (0-1) of an already sorted array. */
+	float GetPercentile(const TArray<float>& Sorted, float Percentile)
+	{
+		if (Sorted.Num() == 0)
+		{
+			return 0.0f;
+		}
+		const int32 Index = FMath::Clamp(FMath::CeilToInt(Percentile * Sorted.Num()) - 1, 0, Sorted.Num() - 1);
+		return Sorted[Index];
+	}
+
+	float GetAverage(const TArray<float>& Values)
+	{
+		float Sum = 0.0f;
+		for (float Value : Values)
+		{
+			Sum += Value;
+		}
+		return Values.Num() > 0 ? Sum / Values.Num() : 0.0f;
+	}
+
+	/** Appends "Name": { "p50": .., "p90": .., "p99": .., "max": .., "avg": .. } */
+	void AppendDistribution(FString& Json, const TCHAR* Name, TArray<float> Values)
+	{
+		Values.Sort();
+		Json += FString::Printf(TEXT("\t\"%s\": { \"samples\": %d, \"avg\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n"),
+			Name, Values.Num(), GetAverage(Values), GetPercentile(Values, 0.5f), GetPercentile(Values, 0.9f), GetPercentile(Values, 0.99f), Values.Num() > 0 ? Values.Last() : 0.0f);
+	}
+}
+
+TestServer::TestServer(UWorld* InWorld, const FString& InReportPath, float InWarmupTime, float InDuration)
+	: World(InWorld)
+	, ReportPath(InReportPath)
+	, WarmupTime(InWarmupTime)
+	, Duration(InDuration)
+	, StartTime(FPlatformTime::Seconds())
+	, RecordStartTime(0.0)
+	, LastConnectionSampleTime(0.0)
+	, bRecording(false)
+	, bFinished(false)
+	, MaxConnections(0)
+	, GCStartTime(0.0)
+{
+	// Roughly a 30Hz server for ten minutes.
+	FrameTimes.Reserve(18000);
+
+	PreGCHandle = FCoreUObjectDelegates::GetPreGarbageCollectDelegate().AddRaw(this, &TestServer::OnPreGarbageCollect);
+	PostGCHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &TestServer::OnPostGarbageCollect);
+
+	UE_LOG(LogWSNetProd, Display, TEXT("Load test recording to %s after %.0fs warmup, for %.0fs."), *ReportPath, WarmupTime, Duration);
 }
 
 TestServer::~TestServer()
 {
+	FCoreUObjectDelegates::GetPreGarbageCollectDelegate().Remove(PreGCHandle);
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGCHandle);
+}
+
+bool TestServer::IsTickable() const
+{
+	return !bFinished;
+}
+
+TStatId TestServer::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(TestServer, STATGROUP_Tickables);
+}
+
+void TestServer::Tick(float DeltaTime)
+{
+	const double Now = FPlatformTime::Seconds();
+
+	if (!bRecording)
+	{
+		if (Now - StartTime < WarmupTime)
+		{
+			return;
+		}
+		bRecording = true;
+		RecordStartTime = Now;
+		LastConnectionSampleTime = Now;
+		RpcCountsAtStart = WSNetProdRpcStats::GetCounts();
+		UE_LOG(LogWSNetProd, Display, TEXT("Load test recording started."));
+	}
+
+	// Time spent sleeping to hold the server tick rate is not load.
+	const double WorkSeconds = FMath::Max(FApp::GetDeltaTime() - FApp::GetIdleTime(), 0.0);
+	FrameTimes.Add((float)(WorkSeconds * 1000.0));
+
+	if (Now - LastConnectionSampleTime >= 1.0)
+	{
+		LastConnectionSampleTime = Now;
+		SampleConnections();
+	}
+
+	if (Now - RecordStartTime >= Duration)
+	{
+		bFinished = true;
+		const bool bWritten = WriteReport();
+		UE_LOG(LogWSNetProd, Display, TEXT("Load test finished, report %s %s."), bWritten ? TEXT("written to") : TEXT("could not be written to"), *ReportPath);
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+void TestServer::SampleConnections()
+{
+	UNetDriver* NetDriver = World.IsValid() ? World->GetNetDriver() : nullptr;
+	if (NetDriver == nullptr)
+	{
+		return;
+	}
+
+	MaxConnections = FMath::Max(MaxConnections, NetDriver->ClientConnections.Num());
+	for (UNetConnection* Connection : NetDriver->ClientConnections)
+	{
+		if (Connection != nullptr)
+		{
+			OutBytesPerSecond.Add((float)Connection->OutBytesPerSecond);
+			InBytesPerSecond.Add((float)Connection->InBytesPerSecond);
+		}
+	}
+}
+
+void TestServer::OnPreGarbageCollect()
+{
+	GCStartTime = FPlatformTime::Seconds();
+}
+
+void TestServer::OnPostGarbageCollect()
+{
+	if (bRecording && GCStartTime > 0.0)
+	{
+		GCPauses.Add((float)((FPlatformTime::Seconds() - GCStartTime) * 1000.0));
+	}
+	GCStartTime = 0.0;
+}
+
+bool TestServer::WriteReport() const
+{
+	const double RecordedSeconds = bRecording ? FPlatformTime::Seconds() - RecordStartTime : 0.0;
+
+	FString Json = TEXT("{\n");
+	Json += FString::Printf(TEXT("\t\"map\": \"%s\",\n"), World.IsValid() ? *World->GetMapName() : TEXT(""));
+	Json += FString::Printf(TEXT("\t\"recordedSeconds\": %.1f,\n"), RecordedSeconds);
+	Json += FString::Printf(TEXT("\t\"maxConnections\": %d,\n"), MaxConnections);
+	AppendDistribution(Json, TEXT("frameMs"), FrameTimes);
+	AppendDistribution(Json, TEXT("outBytesPerSecondPerConnection"), OutBytesPerSecond);
+	AppendDistribution(Json, TEXT("inBytesPerSecondPerConnection"), InBytesPerSecond);
+	AppendDistribution(Json, TEXT("gcPauseMs"), GCPauses);
+
+	Json += TEXT("\t\"rpcs\": {");
+	bool bFirst = true;
+	for (const TPair<FName, uint64>& Pair : WSNetProdRpcStats::GetCounts())
+	{
+		const uint64* AtStart = RpcCountsAtStart.Find(Pair.Key);
+		Json += FString::Printf(TEXT("%s\n\t\t\"%s\": %llu"), bFirst ? TEXT("") : TEXT(","), *Pair.Key.ToString(), Pair.Value - (AtStart ? *AtStart : 0));
+		bFirst = false;
+	}
+	Json += TEXT("\n\t}\n}\n");
+
+	const FString Directory = FPaths::GetPath(ReportPath);
+	if (!Directory.IsEmpty())
+	{
+		IFileManager::Get().MakeDirectory(*Directory, true);
+	}
+	return FFileHelper::SaveStringToFile(Json, *ReportPath);
 }
@@ -3,13 +3,69 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Tickable.h"
+
+class UWorld;
 
 /**
- * 
+ * Records server performance during a load test and writes it out as a JSON report:
+ * game thread frame time percentiles (excluding the idle wait for the tick rate), bandwidth per client
+ * connection, gameplay RPC counts and garbage collection pauses.
+ * Created by ULoadTestSubsystem on servers started with -LoadTestRecord=<report path>.
  */
-class WSNETPROD_API TestServer
+class WSNETPROD_API TestServer : public FTickableGameObject
 {
 public:
-	TestServer();
+	/**
+	 * @param InWorld			World whose net driver is sampled
+	 * @param InReportPath		File the JSON report is written to
+	 * @param InWarmupTime		Seconds to wait before recording, so loading and bots joining are left out
+	 * @param InDuration		Seconds to record for. The process exits once the report is written
+	 */
+	TestServer(UWorld* InWorld, const FString& InReportPath, float InWarmupTime, float InDuration);
 	~TestServer();
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	// End of FTickableGameObject interface
+
+	/** Writes the report with everything recorded so far. */
+	bool WriteReport() const;
+
+private:
+	void SampleConnections();
+
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
+
+	TWeakObjectPtr<UWorld> World;
+	FString ReportPath;
+	float WarmupTime;
+	float Duration;
+
+	double StartTime;
+	double RecordStartTime;
+	double LastConnectionSampleTime;
+	bool bRecording;
+	bool bFinished;
+
+	/** Game thread work per frame, in milliseconds */
+	TArray<float> FrameTimes;
+
+	/** Per connection bytes per second, one entry per connection per second */
+	TArray<float> OutBytesPerSecond;
+	TArray<float> InBytesPerSecond;
+
+	int32 MaxConnections;
+
+	/** RPC counts when recording started, subtracted in the report */
+	TMap<FName, uint64> RpcCountsAtStart;
+
+	TArray<float> GCPauses;
+	double GCStartTime;
+
+	FDelegateHandle PreGCHandle;
+	FDelegateHandle PostGCHandle;
 };
@@ -3,5 +3,53 @@
 #include "WSNetProd.h"
 #include "Modules/ModuleManager.h"
 
+DEFINE_LOG_CATEGORY(LogWSNetProd);
+DEFINE_LOG_CATEGORY(LogWSNetProdShots);
+
+DEFINE_STAT(STAT_WSNetProd_FireBullet);
+DEFINE_STAT(STAT_WSNetProd_ServerFireShots);
+DEFINE_STAT(STAT_WSNetProd_ConfirmHit);
+DEFINE_STAT(STAT_WSNetProd_ApplyDamage);
+DEFINE_STAT(STAT_WSNetProd_Reload);
+DEFINE_STAT(STAT_WSNetProd_EquipSlot);
+DEFINE_STAT(STAT_WSNetProd_RecordHitboxes);
+DEFINE_STAT(STAT_WSNetProd_StepProjectiles);
+DEFINE_STAT(STAT_WSNetProd_CombatStep);
+
+DEFINE_STAT(STAT_WSNetProd_Traces);
+DEFINE_STAT(STAT_WSNetProd_HitsConfirmed);
+DEFINE_STAT(STAT_WSNetProd_HitsRejected);
+DEFINE_STAT(STAT_WSNetProd_RPCs);
+DEFINE_STAT(STAT_WSNetProd_RejectedRPCs);
+DEFINE_STAT(STAT_WSNetProd_Reloads);
+DEFINE_STAT(STAT_WSNetProd_CombatSteps);
+DEFINE_STAT(STAT_WSNetProd_RPCsPerConnection);
+
+namespace WSNetProdRpcStats
+{
+	static TMap<FName, uint64> Counts;
+
+	static uint32 NumThisFrame = 0;
+
+	void Count(FName FunctionName)
+	{
+		Counts.FindOrAdd(FunctionName)++;
+		NumThisFrame++;
+		INC_DWORD_STAT(STAT_WSNetProd_RPCs);
+	}
+
+	uint32 ConsumeFrameCount()
+	{
+		const uint32 FrameCount = NumThisFrame;
+		NumThisFrame = 0;
+		return FrameCount;
+	}
+
+	const TMap<FName, uint64>& GetCounts()
+	{
+		return Counts;
+	}
+}
+
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, WSNetProd, "WSNetProd" );
  
\ No newline at end of file
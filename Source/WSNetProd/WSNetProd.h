@@ -3,3 +3,52 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogWSNetProd, Log, All);
+
+/** Per shot, hit and reload logging. Silent unless raised with "log LogWSNetProdShots Verbose", compiled out of Shipping. */
+#if UE_BUILD_SHIPPING
+DECLARE_LOG_CATEGORY_EXTERN(LogWSNetProdShots, Warning, Warning);
+#else
+DECLARE_LOG_CATEGORY_EXTERN(LogWSNetProdShots, Warning, All);
+#endif
+
+/** Gameplay hot path stats, shown by "stat WSNetProd" and captured by Insights with -statnamedevents. */
+DECLARE_STATS_GROUP(TEXT("WSNetProd"), STATGROUP_WSNetProd, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Fire Bullet"), STAT_WSNetProd_FireBullet, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Server Fire Shots"), STAT_WSNetProd_ServerFireShots, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Confirm Hit"), STAT_WSNetProd_ConfirmHit, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Apply Damage"), STAT_WSNetProd_ApplyDamage, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Reload"), STAT_WSNetProd_Reload, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Equip Slot"), STAT_WSNetProd_EquipSlot, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Record Hitboxes"), STAT_WSNetProd_RecordHitboxes, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Step Simulated Projectiles"), STAT_WSNetProd_StepProjectiles, STATGROUP_WSNetProd, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Combat Step"), STAT_WSNetProd_CombatStep, STATGROUP_WSNetProd, );
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Weapon Traces"), STAT_WSNetProd_Traces, STATGROUP_WSNetProd, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Hits Confirmed"), STAT_WSNetProd_HitsConfirmed, STATGROUP_WSNetProd, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Hits Rejected"), STAT_WSNetProd_HitsRejected, STATGROUP_WSNetProd, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Gameplay RPCs"), STAT_WSNetProd_RPCs, STATGROUP_WSNetProd, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Rejected RPCs"), STAT_WSNetProd_RejectedRPCs, STATGROUP_WSNetProd, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Reloads"), STAT_WSNetProd_Reloads, STATGROUP_WSNetProd, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Combat Steps"), STAT_WSNetProd_CombatSteps, STATGROUP_WSNetProd, );
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Gameplay RPCs Per Connection"), STAT_WSNetProd_RPCsPerConnection, STATGROUP_WSNetProd, );
+
+/** Gameplay RPCs sent and received by this process, by function name. Read by the load test recorder. */
+namespace WSNetProdRpcStats
+{
+	WSNETPROD_API void Count(FName FunctionName);
+
+	WSNETPROD_API const TMap<FName, uint64>& GetCounts();
+
+	/** RPCs counted since the last call. Called once a frame by the replication graph. */
+	WSNETPROD_API uint32 ConsumeFrameCount();
+}
+
+/** Purely cosmetic work (debug draws, particle effects) is compiled out of dedicated server builds. */
+#define WITH_WSNETPROD_COSMETICS (!UE_SERVER)
+
+/** Weapon trace channel. Blocked by world geometry and character hitboxes, ignored by capsules and character meshes. See DefaultEngine.ini. */
+#define ECC_Hitbox ECC_GameTraceChannel1
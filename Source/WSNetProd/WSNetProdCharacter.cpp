@@ -17,6 +17,35 @@
 #include "TimerManager.h"
 #include "Blueprint/UserWidget.h"
 #include "CollisionQueryParams.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameStateBase.h"
+#include "HitboxHistoryComponent.h"
+#include "HitboxPoseCacheComponent.h"
+#include "CharacterVitalsComponent.h"
+#include "WeaponInventoryComponent.h"
+#include "CrosshairComponent.h"
+#include "CombatClock.h"
+#include "WSNetProdSignificanceManager.h"
+#include "HeadlessProfile.h"
+#include "ProjectileSimulation.h"
+#include "WSNetProd.h"
+#include "HAL/IConsoleManager.h"
+#include "Particles/ParticleSystemComponent.h"
+
+// Characters further than this from a shot's path are not rewound for it.
+static const float LagCompensationCullRadius = 400.0f;
+
+// Upper bound on unacknowledged shots kept for resending, oldest are dropped first.
+static const int32 MaxPendingShots = 32;
+
+// Shots the server would refuse to rewind for are not worth resending.
+static const float MaxPendingShotAge = 1.0f;
+
+// True if sequence A comes after B, allowing for wrap around.
+static bool IsNewerShotSequence(uint16 A, uint16 B)
+{
+	return (int16)(A - B) > 0;
+}
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -24,6 +53,9 @@
 
 AWSNetProdCharacter::AWSNetProdCharacter()
 {
+	// Weapon handling is event driven, nothing here needs to run every frame.
+	PrimaryActorTick.bCanEverTick = false;
+
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
 
@@ -66,6 +98,10 @@ AWSNetProdCharacter::AWSNetProdCharacter()
 	ThirdPersonGunMesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("ThirdPersonGunMesh"));
 	ThirdPersonGunMesh->SetupAttachment(GetMesh());
 
+	WeaponInventory = CreateDefaultSubobject<UWeaponInventoryComponent>(TEXT("WeaponInventory"));
+
+	Crosshair = CreateDefaultSubobject<UCrosshairComponent>(TEXT("Crosshair"));
+
 	CBoxHead = CreateDefaultSubobject<UBoxComponent>(TEXT("CBoxHead"));
 	CBoxHead->SetupAttachment(GetMesh());
 	CBoxTorso = CreateDefaultSubobject<UBoxComponent>(TEXT("CBoxTorso"));
@@ -83,19 +119,45 @@ AWSNetProdCharacter::AWSNetProdCharacter()
 	CBoxRightLeg = CreateDefaultSubobject<UBoxComponent>(TEXT("CBoxRightLeg"));
 	CBoxRightLeg->SetupAttachment(GetMesh());
 
+	HitboxHistory = CreateDefaultSubobject<UHitboxHistoryComponent>(TEXT("HitboxHistory"));
+	HitboxPoseCache = CreateDefaultSubobject<UHitboxPoseCacheComponent>(TEXT("HitboxPoseCache"));
+	MaxLagCompensationTime = 0.3f;
+
+	ShotResendInterval = 0.1f;
+	MaxShotOriginError = 250.0f;
+	NextShotSequence = 0;
+	LastProcessedShotSequence = 0;
+	bHasProcessedShot = false;
+	ConfirmedShotMask = 0;
+	bShotAckPending = false;
+	LastAckedShotSequence = 0;
+	bHasAckedShot = false;
+	PredictedAmmo = 0;
+	bPredictingAmmo = false;
+	LastShotBeforeReload = 0;
+	bAwaitingReloadAck = false;
+
+	LastDamagedTime = -BIG_NUMBER;
+	Significance = ECharacterSignificance::High;
+
 	// set mesh location/rotation in cap comp
 	this->GetMesh()->SetRelativeLocation(FVector(0.0f, 0.0f, -95.0f));
 	this->GetMesh()->SetRelativeRotation(FRotator(0.0f, -90.0f, 0.0f));
 
 	//Initialize the player's Health
 	MaxHealth = 100.0f;
-	CurrentHealth = MaxHealth;
+	Vitals = CreateDefaultSubobject<UCharacterVitalsComponent>(TEXT("Vitals"));
+	Vitals->SetHealth(MaxHealth);
 
 	// Note: The skeletal mesh and anim blueprint references on the Mesh component (inherited from Character) 
 	// are set in the derived blueprint asset named MyCharacter (to avoid direct content references in C++)
 
 	
 	CurrentlyEquipped = FirstPersonGunActorSlot1;
+
+#if UE_SERVER
+	StripCosmeticComponents();
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -133,9 +195,11 @@ void AWSNetProdCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Toggle visibility of skel mesh and arm on our self
+	// Toggle visibility of skel mesh and arm on our self. Servers have nothing to show.
 	AWSNetProdCharacter* PlayerCharacter = Cast<AWSNetProdCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-	if (PlayerCharacter == this) {
+	if (WSNetProdHeadless::IsHeadless(this)) {
+		// Cosmetics were already stripped in PostInitializeComponents
+	} else if (PlayerCharacter == this) {
 		this->GetMesh()->ToggleVisibility(false);
 		ThirdPersonGunMesh->ToggleVisibility(false);
 	} else
@@ -145,16 +209,69 @@ void AWSNetProdCharacter::BeginPlay()
 		FirstPersonGunActorSlot2->ToggleVisibility(false);
 	}
 
-	ReloadGun(PlayerCharacter);
+	// Only our own first person gun is ever seen.
+	WeaponInventory->SetWeaponsVisible(PlayerCharacter == this && !WSNetProdHeadless::IsHeadless(this));
+	EquipSlot(CurrentlyEquipped);
+
+	// Only clients throttle other characters, the server needs their real poses for lag compensation.
+	if (GetNetMode() == NM_Client)
+	{
+		if (UWSNetProdSignificanceManager* SignificanceManager = USignificanceManager::Get<UWSNetProdSignificanceManager>(GetWorld()))
+		{
+			// Update rate optimization skips evaluation frames on top of the significance level's tick rate.
+			GetMesh()->bEnableUpdateRateOptimizations = true;
+			DefaultAnimTickOption = GetMesh()->VisibilityBasedAnimTickOption;
+			SignificanceManager->RegisterCharacter(this);
+
+			// Other players' first person arms are never shown, whatever their significance. Ours are turned back on in PawnClientRestart.
+			FirstPersonMesh->SetComponentTickEnabled(IsLocallyControlled());
+		}
+	}
+
+	// Ammo is the server's to hand out, the owning client receives it with the initial replication.
+	if (Role == ROLE_Authority)
+	{
+		RefillAmmo();
+
+		// Shots from the owning client are processed on combat steps, not as their RPCs happen to arrive.
+		CombatClock = ACombatClock::Get(this);
+		if (CombatClock != nullptr)
+		{
+			CombatStepHandle = CombatClock->OnCombatStep.AddUObject(this, &AWSNetProdCharacter::ProcessStepShots);
+		}
+	}
 }
 
-// Called every frame
-void AWSNetProdCharacter::Tick(float DeltaTime)
+void AWSNetProdCharacter::PostInitializeComponents()
 {
-	Super::Tick(DeltaTime);
-	HandleSlotInput_Implementation();
-	//UE_LOG(LogTemp, Warning, TEXT("%f"), GetCurrentHealth());
-	
+	Super::PostInitializeComponents();
+
+	if (WSNetProdHeadless::IsHeadless(this))
+	{
+		StripCosmeticComponents();
+	}
+
+	Vitals->OnHealthChanged.AddUObject(this, &AWSNetProdCharacter::OnHealthUpdate);
+
+	SetupHitboxCollision();
+
+	const TArray<UBoxComponent*> Hitboxes = { CBoxHead, CBoxTorso, CBoxLeftArmUpper, CBoxLeftArmLower, CBoxRightArmUpper, CBoxRightArmLower, CBoxLeftLeg, CBoxRightLeg };
+	HitboxHistory->SetHitboxes(Hitboxes);
+	HitboxPoseCache->SetHitboxes(GetMesh(), Hitboxes);
+
+	WeaponInventory->InitializeSlots({ FirstPersonGunActorSlot1, FirstPersonGunActorSlot2 });
+
+	// The history records whatever pose the cache put the hitboxes in this frame.
+	HitboxHistory->PrimaryComponentTick.AddPrerequisite(HitboxPoseCache, HitboxPoseCache->PrimaryComponentTick);
+}
+
+void AWSNetProdCharacter::StripCosmeticComponents()
+{
+	// The first person view, camera and third person gun are only ever seen by players.
+	WSNetProdHeadless::StripCosmeticComponent(CameraBoom);
+	WSNetProdHeadless::StripCosmeticComponent(FollowCamera);
+	WSNetProdHeadless::StripCosmeticComponent(FirstPersonMesh);
+	WSNetProdHeadless::StripCosmeticComponent(ThirdPersonGunMesh);
 }
 
 void AWSNetProdCharacter::TouchStarted(ETouchIndex::Type FingerIndex, FVector Location)
@@ -214,21 +331,150 @@ void AWSNetProdCharacter::GetLifetimeReplicatedProps(TArray <FLifetimeProperty>
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
-	//Replicate current health.
-	DOREPLIFETIME(AWSNetProdCharacter, CurrentHealth);
-	DOREPLIFETIME(AWSNetProdCharacter, CurrentAmmo);
+	// Health and ammo live in Vitals, replicated below.
+
+	DOREPLIFETIME_CONDITION(AWSNetProdCharacter, CombatState, COND_SkipOwner);
+}
+
+void AWSNetProdCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+	CombatState.SetAim(GetBaseAimRotation());
+	CombatState.EquippedSlot = GetSlotIndex(CurrentlyEquipped);
+	CombatState.bReloading = bReloading;
+
+	// CombatState carries pitch at twice the resolution, the engine's copy would only be sent alongside it.
+	DOREPLIFETIME_ACTIVE_OVERRIDE(APawn, RemoteViewPitch, false);
+}
+
+FRotator AWSNetProdCharacter::GetBaseAimRotation() const
+{
+	if (Role == ROLE_SimulatedProxy)
+	{
+		return CombatState.GetAim();
+	}
+	return Super::GetBaseAimRotation();
+}
+
+void AWSNetProdCharacter::OnRep_CombatState()
+{
+	if (CombatState.EquippedSlot != AppliedCombatState.EquippedSlot)
+	{
+		EquipSlot(GetSlotByIndex(CombatState.EquippedSlot));
+	}
+
+	if (CombatState.bReloading != AppliedCombatState.bReloading)
+	{
+		bReloading = CombatState.bReloading;
+	}
+
+	if (CombatState.bFiring != AppliedCombatState.bFiring)
+	{
+		ReceiveRemoteFiringChanged(CombatState.bFiring);
+	}
+
+	AppliedCombatState = CombatState;
+}
+
+void AWSNetProdCharacter::ClearCombatFiring()
+{
+	CombatState.bFiring = false;
+}
+
+bool AWSNetProdCharacter::ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
+{
+	bool bWroteSomething = Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
+	bWroteSomething |= Vitals->ReplicateIfDirty(Channel, Bunch, RepFlags);
+	return bWroteSomething;
+}
+
+float AWSNetProdCharacter::GetCurrentHealth() const
+{
+	return Vitals->GetHealth();
+}
+
+int AWSNetProdCharacter::GetCurrentAmmo() const
+{
+	return bPredictingAmmo ? PredictedAmmo : Vitals->GetAmmo();
+}
+
+void AWSNetProdCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (CombatClock != nullptr)
+	{
+		CombatClock->OnCombatStep.Remove(CombatStepHandle);
+	}
+
+	if (UWSNetProdSignificanceManager* SignificanceManager = USignificanceManager::Get<UWSNetProdSignificanceManager>(GetWorld()))
+	{
+		SignificanceManager->UnregisterCharacter(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AWSNetProdCharacter::PawnClientRestart()
+{
+	Super::PawnClientRestart();
+
+	if (!WSNetProdHeadless::IsHeadless(this))
+	{
+		Crosshair->OnLocallyControlled();
+	}
+
+	// Possession can arrive after BeginPlay turned the arms off.
+	FirstPersonMesh->SetComponentTickEnabled(true);
+}
+
+void AWSNetProdCharacter::SetSignificance(ECharacterSignificance Level)
+{
+	if (Level == Significance)
+	{
+		return;
+	}
+	Significance = Level;
+
+	// Animation and hitbox placement only happen when the meshes tick, so their interval is the update rate.
+	float TickInterval = 0.0f;
+	switch (Level)
+	{
+	case ECharacterSignificance::Culled:
+		TickInterval = 0.25f;
+		break;
+	case ECharacterSignificance::Low:
+		TickInterval = 0.1f;
+		break;
+	case ECharacterSignificance::Medium:
+		TickInterval = 1.0f / 30.0f;
+		break;
+	default:
+		break;
+	}
+
+	USkeletalMeshComponent* Body = GetMesh();
+	Body->SetComponentTickInterval(TickInterval);
+	Body->VisibilityBasedAnimTickOption = Level <= ECharacterSignificance::Low ? EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered : DefaultAnimTickOption.GetValue();
+
+	ThirdPersonGunMesh->SetComponentTickInterval(TickInterval);
+	ThirdPersonGunMesh->SetComponentTickEnabled(Level != ECharacterSignificance::Culled);
+
+	// Simulated movement only smooths what replication already placed.
+	GetCharacterMovement()->SetComponentTickInterval(Level == ECharacterSignificance::Culled ? TickInterval : 0.0f);
 }
 
 void AWSNetProdCharacter::OnHealthUpdate()
 {
+	LastDamagedTime = GetWorld()->GetTimeSeconds();
+
 	//Client-specific functionality
 	if (IsLocallyControlled())
 	{
 		/*
-		 *FString healthMessage = FString::Printf(TEXT("You now have %f health remaining."), CurrentHealth);
+		 *FString healthMessage = FString::Printf(TEXT("You now have %f health remaining."), GetCurrentHealth());
 		GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Blue, healthMessage);
 
-		if (CurrentHealth <= 0)
+		if (GetCurrentHealth() <= 0)
 		{
 			FString deathMessage = FString::Printf(TEXT("You have been killed."));
 			GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Red, deathMessage);
@@ -240,7 +486,7 @@ void AWSNetProdCharacter::OnHealthUpdate()
 	if (Role == ROLE_Authority)
 	{
 		/*
-		FString healthMessage = FString::Printf(TEXT("%s now has %f health remaining."), *GetFName().ToString(), CurrentHealth);
+		FString healthMessage = FString::Printf(TEXT("%s now has %f health remaining."), *GetFName().ToString(), GetCurrentHealth());
 		GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Blue, healthMessage);
 		*/
 	}
@@ -251,53 +497,189 @@ void AWSNetProdCharacter::OnHealthUpdate()
 	*/
 }
 
-void AWSNetProdCharacter::OnRep_CurrentHealth()
-{
-	OnHealthUpdate();
-}
-
 void AWSNetProdCharacter::SetCurrentHealth(float healthValue)
 {
 	if (Role == ROLE_Authority)
 	{
-		CurrentHealth = CurrentHealth - healthValue;
-		OnHealthUpdate();
+		Vitals->SetHealth(Vitals->GetHealth() - healthValue);
 	}
 }
 
 void AWSNetProdCharacter::SetCurrentAmmo_Implementation(float AmmoValue)
 {
+	WSNetProdRpcStats::Count(TEXT("SetCurrentAmmo"));
+
+	if (!SetAmmoBucket.TryConsume(GetWorld()->GetTimeSeconds(), 1.0f, 2.0f))
+	{
+		RejectRequest(ValidationStats.RateLimited);
+		return;
+	}
+
+	if (!FMath::IsFinite(AmmoValue))
+	{
+		RejectRequest(ValidationStats.InvalidArgument);
+		return;
+	}
+
+	// Clients may only give ammo up, never grant themselves more than the server counted.
+	const int32 NewAmmo = FMath::FloorToInt(AmmoValue);
+	if (NewAmmo < 0 || NewAmmo > Vitals->GetAmmo())
+	{
+		RejectRequest(ValidationStats.NoAmmo);
+		return;
+	}
+
+	Vitals->SetAmmo(NewAmmo);
+}
+
+void AWSNetProdCharacter::RejectRequest(int32& Reason)
+{
+	Reason++;
+	INC_DWORD_STAT(STAT_WSNetProd_RejectedRPCs);
+}
+
+void AWSNetProdCharacter::RefillAmmo()
+{
+	if (EquippedWeapon == nullptr)
+	{
+		return;
+	}
+
 	if (Role == ROLE_Authority)
 	{
-		CurrentAmmo = AmmoValue;
-		UE_LOG(LogTemp, Error, TEXT("%s RELOADED #####################"), *this->GetName());
+		Vitals->SetAmmo(EquippedWeapon->GetMagazineSize());
+		return;
+	}
+
+	PredictedAmmo = EquippedWeapon->GetMagazineSize();
+	bPredictingAmmo = true;
+	LastShotBeforeReload = NextShotSequence - 1;
+	bAwaitingReloadAck = PendingShots.Num() > 0;
+}
+
+void AWSNetProdCharacter::SetReloading(bool newReloading)
+{
+	const bool bFinished = bReloading && !newReloading;
+	bReloading = newReloading;
+
+	if (bFinished && EquippedWeapon != nullptr)
+	{
+		EquippedWeapon->OnReloadFinished();
 	}
-	
-	CurrentAmmo = AmmoValue;
 }
 
 void AWSNetProdCharacter::StartFiring()
 {
 	bFiring = true;
+	Crosshair->NotifyFiringChanged(true);
+
+	if (EquippedWeapon != nullptr && !bReloading)
+	{
+		EquippedWeapon->StartFire();
+	}
 }
 
 void AWSNetProdCharacter::StopFiring()
 {
 	bFiring = false;
+	Crosshair->NotifyFiringChanged(false);
+
+	if (EquippedWeapon != nullptr)
+	{
+		EquippedWeapon->StopFire();
+	}
 }
 
-void AWSNetProdCharacter::HandleSlotInput_Implementation()
+void AWSNetProdCharacter::EquipSlot(UChildActorComponent* Slot)
 {
-	AWeaponBase* CWeapon = Cast<AWeaponBase>(CurrentlyEquipped->GetChildActor());
-	if (bFiring && CWeapon != nullptr && !bReloading)
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_EquipSlot);
+
+	// The server fires with its own copy of the weapon, so it has to switch too.
+	if (Slot != CurrentlyEquipped && IsLocallyControlled() && Role < ROLE_Authority)
 	{
-		CWeapon->HandleInput();
+		ServerEquipSlot(GetSlotIndex(Slot));
 	}
+
+	ActivateEquippedSlot(Slot);
 }
 
+void AWSNetProdCharacter::ActivateEquippedSlot(UChildActorComponent* Slot)
+{
+	// Both weapons stay spawned, the inventory only hides one and shows the other.
+	CurrentlyEquipped = Slot;
+	EquippedWeapon = WeaponInventory->ActivateSlot(GetSlotIndex(Slot));
 
-void AWSNetProdCharacter::ServerApplyDamage_Implementation(float someDEEPS, AActor* target)
+	if (EquippedWeapon != nullptr)
+	{
+		if (bFiring && !bReloading)
+		{
+			EquippedWeapon->StartFire();
+		}
+	}
+}
+
+
+uint8 AWSNetProdCharacter::GetSlotIndex(const UChildActorComponent* Slot) const
+{
+	if (Slot != nullptr && Slot == FirstPersonGunActorSlot1)
+	{
+		return 1;
+	}
+	if (Slot != nullptr && Slot == FirstPersonGunActorSlot2)
+	{
+		return 2;
+	}
+	return 0;
+}
+
+UChildActorComponent* AWSNetProdCharacter::GetSlotByIndex(uint8 SlotIndex) const
+{
+	switch (SlotIndex)
+	{
+	case 1:
+		return FirstPersonGunActorSlot1;
+	case 2:
+		return FirstPersonGunActorSlot2;
+	default:
+		return nullptr;
+	}
+}
+
+void AWSNetProdCharacter::ServerEquipSlot_Implementation(uint8 SlotIndex)
+{
+	WSNetProdRpcStats::Count(TEXT("ServerEquipSlot"));
+
+	if (!EquipBucket.TryConsume(GetWorld()->GetTimeSeconds(), 2.0f, 3.0f))
+	{
+		RejectRequest(ValidationStats.RateLimited);
+		ClientCorrectEquippedSlot(GetSlotIndex(CurrentlyEquipped));
+		return;
+	}
+
+	UChildActorComponent* Slot = GetSlotByIndex(SlotIndex);
+	if (Slot == nullptr)
+	{
+		RejectRequest(ValidationStats.InvalidArgument);
+		ClientCorrectEquippedSlot(GetSlotIndex(CurrentlyEquipped));
+		return;
+	}
+
+	EquipSlot(Slot);
+}
+
+void AWSNetProdCharacter::ClientCorrectEquippedSlot_Implementation(uint8 SlotIndex)
+{
+	UChildActorComponent* Slot = GetSlotByIndex(SlotIndex);
+	if (Slot != nullptr && Slot != CurrentlyEquipped)
+	{
+		ActivateEquippedSlot(Slot);
+	}
+}
+
+void AWSNetProdCharacter::ApplyHitDamage(float someDEEPS, AActor* target)
 {
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_ApplyDamage);
+
 	AWSNetProdCharacter* ptr = Cast<AWSNetProdCharacter>(target);
 	if(ptr)
 	{
@@ -306,53 +688,476 @@ void AWSNetProdCharacter::ServerApplyDamage_Implementation(float someDEEPS, AAct
 }
 
 
+void AWSNetProdCharacter::SetupHitboxCollision()
+{
+	// Set at runtime so blueprint overrides of the components' collision cannot put them back on other channels.
+	for (UBoxComponent* Hitbox : { CBoxHead, CBoxTorso, CBoxLeftArmUpper, CBoxLeftArmLower, CBoxRightArmUpper, CBoxRightArmLower, CBoxLeftLeg, CBoxRightLeg })
+	{
+		Hitbox->SetCollisionProfileName(TEXT("Hitbox"));
+	}
+
+	GetCapsuleComponent()->SetCollisionResponseToChannel(ECC_Hitbox, ECR_Ignore);
+	GetMesh()->SetCollisionResponseToChannel(ECC_Hitbox, ECR_Ignore);
+	FirstPersonMesh->SetCollisionResponseToChannel(ECC_Hitbox, ECR_Ignore);
+	ThirdPersonGunMesh->SetCollisionResponseToChannel(ECC_Hitbox, ECR_Ignore);
+}
+
+EHitRegion AWSNetProdCharacter::GetHitRegion(const UPrimitiveComponent* Component) const
+{
+	if (Component == nullptr)
+	{
+		return EHitRegion::None;
+	}
+	if (Component == CBoxHead)
+	{
+		return EHitRegion::Head;
+	}
+	if (Component == CBoxTorso)
+	{
+		return EHitRegion::Torso;
+	}
+	if (Component == CBoxLeftArmUpper || Component == CBoxLeftArmLower || Component == CBoxRightArmUpper || Component == CBoxRightArmLower)
+	{
+		return EHitRegion::Arm;
+	}
+	if (Component == CBoxLeftLeg || Component == CBoxRightLeg)
+	{
+		return EHitRegion::Leg;
+	}
+	return EHitRegion::None;
+}
+
 bool AWSNetProdCharacter::GetIsMoving()
 {
-	if (GetVelocity().Size() > 0) { return true; } else { return false; }
+	return GetVelocity().SizeSquared() > 0.0f;
 }
 
 bool AWSNetProdCharacter::GetIsFiring()
 {
-	return bFiring;
+	return bFiring || CombatState.bFiring;
 }
 
-void AWSNetProdCharacter::ServerLineTrace_Implementation(FVector LineTraceStart, FVector LineTraceEnd, AActor* SourceGun, AActor* SourcePlayer)
+uint16 AWSNetProdCharacter::QueueShot(const FVector& Start, const FVector& Direction, float ClientTime, bool bClaimedHit)
 {
-	FHitResult ServerSingleHit;
-	FCollisionQueryParams Params;
-	Params.AddIgnoredActor(SourceGun);
-	Params.AddIgnoredActor(SourcePlayer);
-	
-	
-	bool ServerBulletTrace = GetWorld()->LineTraceSingleByChannel(ServerSingleHit, LineTraceStart, LineTraceEnd, ECC_Visibility, Params);
+	FQuantizedShot Shot;
+	Shot.Start = Start;
+	Shot.Direction = Direction;
+	Shot.ClientTime = ClientTime;
+	Shot.Sequence = NextShotSequence++;
+	Shot.bClaimedHit = bClaimedHit;
+
+	if (Role == ROLE_Authority)
+	{
+		ProcessShot(Shot);
+		return Shot.Sequence;
+	}
 
+	// Spend the ammo locally now, the server's count comes back with the ack.
+	if (!bPredictingAmmo)
+	{
+		PredictedAmmo = Vitals->GetAmmo();
+		bPredictingAmmo = true;
+	}
+	PredictedAmmo = FMath::Max(PredictedAmmo - 1, 0);
 
-	if (ServerBulletTrace && IsValid(Cast<AWSNetProdCharacter>(ServerSingleHit.GetComponent()->GetAttachmentRootActor()))) // has the trace hit anything & if there is a component, is it attached to the player?
+	if (PendingShots.Num() >= MaxPendingShots)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Server hit: %s"), *ServerSingleHit.GetActor()->GetName());
-		AWeaponBase* CurrentlyEquippedGun = Cast<AWeaponBase>(CurrentlyEquipped->GetChildActor());
-		ServerApplyDamage(CurrentlyEquippedGun->GetDamage(), ServerSingleHit.Actor.Get());
-	}	
+		PendingShots.RemoveAt(0, 1, false);
+	}
+	PendingShots.Add(Shot);
+
+	// Everything fired this frame goes out together in one batch.
+	GetWorldTimerManager().ClearTimer(ShotFlushTimer);
+	ShotFlushTimer = GetWorldTimerManager().SetTimerForNextTick(this, &AWSNetProdCharacter::FlushShots);
+
+	return Shot.Sequence;
 }
 
-void AWSNetProdCharacter::ReloadGun_Implementation(AActor* ReloadTargetPlayer)
+void AWSNetProdCharacter::PredictHit(uint16 PredictionKey, const FHitResult& Hit, EHitRegion Region)
 {
-	bReloading = true;
-	AWeaponBase* gun = Cast<AWeaponBase>(CurrentlyEquipped->GetChildActor());
+	FPredictedHit PredictedHit;
+	PredictedHit.PredictionKey = PredictionKey;
+
+#if WITH_WSNETPROD_COSMETICS
+	UParticleSystem* ImpactEffect = EquippedWeapon ? EquippedWeapon->HitImpactEffect : nullptr;
+	if (ImpactEffect != nullptr)
+	{
+		PredictedHit.ImpactEffect = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), ImpactEffect, Hit.ImpactPoint, Hit.ImpactNormal.Rotation());
+	}
+#endif
+
+	ReceivePredictedHit(PredictionKey, Hit, Region);
+
+	// The server's own shots need no confirmation.
+	if (Role < ROLE_Authority)
+	{
+		PredictedHits.Add(PredictedHit);
+	}
+}
+
+void AWSNetProdCharacter::ResolvePredictedHits(uint16 LastSequence, uint32 ConfirmedMask)
+{
+	int32 NumResolved = 0;
+	while (NumResolved < PredictedHits.Num() && !IsNewerShotSequence(PredictedHits[NumResolved].PredictionKey, LastSequence))
+	{
+		// Shots the server never saw, or too old for the mask, count as rejected.
+		const uint16 Age = LastSequence - PredictedHits[NumResolved].PredictionKey;
+		if (Age >= 32 || (ConfirmedMask & (1u << Age)) == 0)
+		{
+			RollbackPredictedHit(PredictedHits[NumResolved]);
+		}
+		NumResolved++;
+	}
+	PredictedHits.RemoveAt(0, NumResolved, false);
+}
+
+void AWSNetProdCharacter::RollbackPredictedHit(const FPredictedHit& PredictedHit)
+{
+	if (UParticleSystemComponent* ImpactEffect = PredictedHit.ImpactEffect.Get())
+	{
+		ImpactEffect->DestroyComponent();
+	}
+
+	UE_LOG(LogWSNetProdShots, Verbose, TEXT("%s: predicted hit %d rejected"), *GetName(), PredictedHit.PredictionKey);
+	ReceivePredictedHitRejected(PredictedHit.PredictionKey);
+}
+
+void AWSNetProdCharacter::FlushShots()
+{
+	// Drop shots too old to be honoured, they would only waste bandwidth.
+	AGameStateBase* GameState = GetWorld()->GetGameState();
+	const float Now = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	int32 NumExpired = 0;
+	while (NumExpired < PendingShots.Num() && Now - PendingShots[NumExpired].ClientTime > MaxPendingShotAge)
+	{
+		NumExpired++;
+	}
+	if (NumExpired > 0)
+	{
+		// Never sent, so never confirmed.
+		ResolvePredictedHits(PendingShots[NumExpired - 1].Sequence, 0);
+		PendingShots.RemoveAt(0, NumExpired, false);
+	}
 
-	AWSNetProdCharacter* reloadtarget = Cast<AWSNetProdCharacter>(ReloadTargetPlayer);
+	if (PendingShots.Num() == 0)
+	{
+		return;
+	}
+
+	ServerFireShots(PendingShots);
+
+	// Resend until acknowledged.
+	GetWorldTimerManager().SetTimer(ShotFlushTimer, this, &AWSNetProdCharacter::FlushShots, ShotResendInterval, false);
+}
+
+void AWSNetProdCharacter::ServerFireShots_Implementation(const TArray<FQuantizedShot>& Shots)
+{
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_ServerFireShots);
+	WSNetProdRpcStats::Count(TEXT("ServerFireShots"));
 
-	if (reloadtarget != nullptr)
+	// A well behaved client never holds more than this many unacknowledged shots.
+	if (Shots.Num() > MaxPendingShots)
 	{
-		UE_LOG(LogTemp, Error, TEXT("%s tried reloading #####################"), *reloadtarget->GetName());
-		AWeaponBase* CurrentlyEquippedGun = Cast<AWeaponBase>(CurrentlyEquipped->GetChildActor());
-		reloadtarget->SetCurrentAmmo_Implementation(CurrentlyEquippedGun->GetMagazineSize());
+		RejectRequest(ValidationStats.OutOfRange);
+		return;
+	}
+
+	// New shots are limited to the weapon's fire rate. Clients drop shots older than MaxPendingShotAge,
+	// so at most that much fire can legitimately arrive at once after packet loss.
+	const float Now = GetWorld()->GetTimeSeconds();
+	const float ShotsPerSecond = 1.0f / FMath::Max(EquippedWeapon ? EquippedWeapon->GetFireRate() : 1.0f, 0.01f);
+	const float ShotBurst = FMath::CeilToFloat(MaxPendingShotAge * ShotsPerSecond) + 1.0f;
+	const float MaxOriginErrorSquared = FMath::Square(MaxShotOriginError);
+
+	for (const FQuantizedShot& Shot : Shots)
+	{
+		// Shots already seen in an earlier batch are skipped.
+		if (bHasProcessedShot && !IsNewerShotSequence(Shot.Sequence, LastProcessedShotSequence))
+		{
+			continue;
+		}
+
+		// Rejected shots are still acknowledged so the client stops resending them, their bit stays clear.
+		const uint16 Advance = bHasProcessedShot ? (uint16)(Shot.Sequence - LastProcessedShotSequence) : 32;
+		ConfirmedShotMask = Advance < 32 ? ConfirmedShotMask << Advance : 0;
+		LastProcessedShotSequence = Shot.Sequence;
+		bHasProcessedShot = true;
+
+		if (!ShotBucket.TryConsume(Now, ShotsPerSecond, ShotBurst))
+		{
+			RejectRequest(ValidationStats.RateLimited);
+			continue;
+		}
+
+		if (Shot.Direction.IsNearlyZero())
+		{
+			RejectRequest(ValidationStats.InvalidArgument);
+			continue;
+		}
+
+		// The trace length comes from the server's weapon, only the origin is the client's say.
+		if (FVector::DistSquared(Shot.Start, GetActorLocation()) > MaxOriginErrorSquared)
+		{
+			RejectRequest(ValidationStats.OutOfRange);
+			continue;
+		}
+
+		if (StepShots.Num() >= MaxPendingShots)
+		{
+			RejectRequest(ValidationStats.RateLimited);
+			continue;
+		}
+
+		StepShots.Add(Shot);
+	}
+
+	if (bHasProcessedShot)
+	{
+		bShotAckPending = true;
+	}
+
+	// Without a clock, process right away.
+	if (CombatClock == nullptr)
+	{
+		ProcessStepShots(0);
 	}
 }
 
-void AWSNetProdCharacter::DecreaseAmmo_Implementation(AActor* TargetPlayer)
+void AWSNetProdCharacter::ProcessStepShots(int64 Step)
 {
-	AWSNetProdCharacter* AmmoTargetPlayer = Cast<AWSNetProdCharacter>(TargetPlayer);
-	AmmoTargetPlayer->SetCurrentAmmo_Implementation(CurrentAmmo - 1);
+	for (const FQuantizedShot& Shot : StepShots)
+	{
+		// The mask has moved on with every shot received since, so the shot's bit is found by its age.
+		const uint16 Age = LastProcessedShotSequence - Shot.Sequence;
+		if (ProcessShot(Shot) && Age < 32)
+		{
+			ConfirmedShotMask |= 1u << Age;
+		}
+	}
+	StepShots.Reset();
+
+	if (bShotAckPending)
+	{
+		bShotAckPending = false;
+		WSNetProdRpcStats::Count(TEXT("ClientAckShots"));
+		ClientAckShots(LastProcessedShotSequence, ConfirmedShotMask, (uint16)FMath::Clamp(Vitals->GetAmmo(), 0, (int32)MAX_uint16));
+	}
 }
 
+void AWSNetProdCharacter::ClientAckShots_Implementation(uint16 LastSequence, uint32 ConfirmedMask, uint16 Ammo)
+{
+	// Acks for shots already settled carry nothing new.
+	if (bHasAckedShot && !IsNewerShotSequence(LastSequence, LastAckedShotSequence))
+	{
+		return;
+	}
+	LastAckedShotSequence = LastSequence;
+	bHasAckedShot = true;
+
+	int32 NumAcked = 0;
+	while (NumAcked < PendingShots.Num() && !IsNewerShotSequence(PendingShots[NumAcked].Sequence, LastSequence))
+	{
+		NumAcked++;
+	}
+	PendingShots.RemoveAt(0, NumAcked, false);
+
+	if (PendingShots.Num() == 0)
+	{
+		GetWorldTimerManager().ClearTimer(ShotFlushTimer);
+	}
+
+	ResolvePredictedHits(LastSequence, ConfirmedMask);
+
+	if (bAwaitingReloadAck)
+	{
+		if (IsNewerShotSequence(LastShotBeforeReload, LastSequence))
+		{
+			return;
+		}
+		bAwaitingReloadAck = false;
+	}
+
+	// Replay the shots still in flight on top of the server's count, which corrects any misprediction.
+	PredictedAmmo = FMath::Max((int32)Ammo - PendingShots.Num(), 0);
+	bPredictingAmmo = true;
+}
+
+bool AWSNetProdCharacter::ProcessShot(const FQuantizedShot& Shot)
+{
+	AWeaponBase* CurrentlyEquippedGun = EquippedWeapon;
+
+	// The reload started when the magazine ran dry may have been rate limited. Retry it rather than stay empty for good.
+	if (CurrentlyEquippedGun != nullptr && Vitals->GetAmmo() <= 0 && !IsLocallyControlled())
+	{
+		ReloadGun_Implementation(this);
+	}
+
+	if (CurrentlyEquippedGun == nullptr || Vitals->GetAmmo() <= 0)
+	{
+		RejectRequest(ValidationStats.NoAmmo);
+		return false;
+	}
+
+	// Nothing on the server says when a remote player's reload animation ends, their next shot does.
+	if (bReloading && !IsLocallyControlled())
+	{
+		bReloading = false;
+	}
+
+	// Other players see the muzzle flash for as long as shots keep coming.
+	if (!CombatState.bFiring)
+	{
+		CombatState.bFiring = true;
+		ForceNetUpdate();
+	}
+	const float FireRate = CurrentlyEquippedGun->GetFireRate();
+	GetWorldTimerManager().SetTimer(CombatFiringTimer, this, &AWSNetProdCharacter::ClearCombatFiring, FMath::Max(FireRate * 2.0f, 0.2f), false);
+
+	bool bConfirmed = true;
+
+	// Ammo and damage are applied together so a shot can never hit without being paid for.
+	Vitals->SetAmmo(Vitals->GetAmmo() - 1);
+
+	if (CurrentlyEquippedGun->FiresSimulatedProjectiles())
+	{
+		AProjectileSimulation::FireSimulatedProjectile(this, Shot.Start, Shot.Direction, this);
+	}
+	else if (Shot.bClaimedHit)
+	{
+		const FVector End = Shot.Start + Shot.Direction * CurrentlyEquippedGun->GetBulletDistance();
+		bConfirmed = ConfirmHit(Shot.Start, End, Shot.ClientTime);
+	}
+
+	// Remote players reload on the server as soon as they run dry, a local player's weapon starts its own reload.
+	if (Vitals->GetAmmo() <= 0 && !IsLocallyControlled())
+	{
+		ReloadGun_Implementation(this);
+	}
+
+	return bConfirmed;
+}
+
+bool AWSNetProdCharacter::ConfirmHit(const FVector& LineTraceStart, const FVector& LineTraceEnd, float ClientTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_ConfirmHit);
+
+	UWorld* World = GetWorld();
+	const float Now = World->GetTimeSeconds();
+	const float RewindTime = FMath::Clamp(ClientTime, Now - MaxLagCompensationTime, Now);
+
+	// Put every character the shot could have passed through back where the shooter saw them.
+	TArray<UHitboxHistoryComponent*, TInlineAllocator<16>> Rewound;
+	for (TActorIterator<AWSNetProdCharacter> It(World); It; ++It)
+	{
+		AWSNetProdCharacter* Target = *It;
+		if (Target == this || Target->HitboxHistory == nullptr)
+		{
+			continue;
+		}
+
+		if (FMath::PointDistToSegmentSquared(Target->GetActorLocation(), LineTraceStart, LineTraceEnd) > FMath::Square(LagCompensationCullRadius))
+		{
+			continue;
+		}
+
+		// Recorded poses of a cached character are baked approximations. Trace against its real pose instead,
+		// moved back to where it stood.
+		bool bRewound;
+		if (Target->HitboxPoseCache->IsActive())
+		{
+			Target->HitboxPoseCache->RefreshFullPose();
+			bRewound = Target->HitboxHistory->RewindPlacementTo(RewindTime);
+		}
+		else
+		{
+			bRewound = Target->HitboxHistory->RewindTo(RewindTime);
+		}
+
+		if (bRewound)
+		{
+			Rewound.Add(Target->HitboxHistory);
+		}
+	}
+
+	FWeaponTraceResult TraceResult;
+	const bool bServerHit = EquippedWeapon->TraceShot(LineTraceStart, LineTraceEnd, this, TraceResult);
+
+	for (UHitboxHistoryComponent* History : Rewound)
+	{
+		History->Restore();
+	}
+
+	if (!bServerHit)
+	{
+		INC_DWORD_STAT(STAT_WSNetProd_HitsRejected);
+		UE_LOG(LogWSNetProdShots, Verbose, TEXT("%s: claimed hit not confirmed"), *GetName());
+	}
+	else
+	{
+		INC_DWORD_STAT(STAT_WSNetProd_HitsConfirmed);
+		UE_LOG(LogWSNetProdShots, Verbose, TEXT("Server hit: %s (%s)"), *TraceResult.Character->GetName(), *StaticEnum<EHitRegion>()->GetNameStringByValue((int64)TraceResult.Region));
+		ApplyHitDamage(EquippedWeapon->GetDamageForRegion(TraceResult.Region), TraceResult.Character);
+	}
+
+	return bServerHit;
+}
+
+void AWSNetProdCharacter::ReloadGun_Implementation(AActor* ReloadTargetPlayer)
+{
+	// Players only ever reload themselves.
+	if (ReloadTargetPlayer != this)
+	{
+		if (Role == ROLE_Authority)
+		{
+			RejectRequest(ValidationStats.InvalidArgument);
+		}
+		return;
+	}
+
+	if (Role == ROLE_Authority)
+	{
+		WSNetProdRpcStats::Count(TEXT("ReloadGun"));
+	}
+
+	if (Role == ROLE_Authority && !ReloadBucket.TryConsume(GetWorld()->GetTimeSeconds(), 1.0f, 2.0f))
+	{
+		RejectRequest(ValidationStats.RateLimited);
+		return;
+	}
+
+	bReloading = true;
+
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_Reload);
+	INC_DWORD_STAT(STAT_WSNetProd_Reloads);
+	UE_LOG(LogWSNetProdShots, Verbose, TEXT("%s reloading"), *GetName());
+	RefillAmmo();
+}
+
+namespace
+{
+	void PrintValidationStats(const TArray<FString>& Args, UWorld* World)
+	{
+		FServerValidationStats Total;
+		for (TActorIterator<AWSNetProdCharacter> It(World); It; ++It)
+		{
+			const FServerValidationStats Stats = It->GetValidationStats();
+			if (Stats.GetTotal() > 0)
+			{
+				UE_LOG(LogWSNetProd, Display, TEXT("%s: %d rate limited, %d out of range, %d invalid, %d without ammo"),
+					*It->GetName(), Stats.RateLimited, Stats.OutOfRange, Stats.InvalidArgument, Stats.NoAmmo);
+			}
+			Total.RateLimited += Stats.RateLimited;
+			Total.OutOfRange += Stats.OutOfRange;
+			Total.InvalidArgument += Stats.InvalidArgument;
+			Total.NoAmmo += Stats.NoAmmo;
+		}
+
+		UE_LOG(LogWSNetProd, Display, TEXT("Rejected client requests: %d total (%d rate limited, %d out of range, %d invalid, %d without ammo)"),
+			Total.GetTotal(), Total.RateLimited, Total.OutOfRange, Total.InvalidArgument, Total.NoAmmo);
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ValidationStatsCommand(
+		TEXT("WSNetProd.ValidationStats"),
+		TEXT("Prints client RPCs the server rejected, per character and in total."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&PrintValidationStats));
+}
@@ -5,10 +5,12 @@
 #include "CoreMinimal.h"
 #include "Engine.h"
 #include "GameFramework/Character.h"
+#include "CombatState.h"
 #include "WSNetProdCharacter.generated.h"
 
 
 class UUserWidget;
+enum class ECharacterSignificance : uint8;
 
 USTRUCT(BlueprintType)
 struct FCrosshair
@@ -26,11 +28,118 @@ struct FCrosshair
 
 };
 
+/** Body region a hitbox belongs to. Weapons scale their damage per region. */
+UENUM(BlueprintType)
+enum class EHitRegion : uint8
+{
+	None,
+	Head,
+	Torso,
+	Arm,
+	Leg
+};
+
+/** A single shot sent from the owning client to the server, quantized for the wire. */
+USTRUCT()
+struct FQuantizedShot
+{
+	GENERATED_BODY()
+
+	/** Trace start, rounded to the nearest unit */
+	UPROPERTY()
+		FVector_NetQuantize Start;
+
+	/** Unit aim direction */
+	UPROPERTY()
+		FVector_NetQuantizeNormal Direction;
+
+	/** Server world time the client fired at, used to rewind targets */
+	UPROPERTY()
+		float ClientTime;
+
+	/** Per-character shot counter, wraps around */
+	UPROPERTY()
+		uint16 Sequence;
+
+	/** Whether the client's own trace hit a character. The server only traces shots that claim a hit. */
+	UPROPERTY()
+		bool bClaimedHit;
+};
+
+/**
+ * Token bucket capping how often a client may make the server do work through an RPC.
+ * Holds up to Capacity tokens, refilled at RefillRate per second. Each accepted call spends one.
+ */
+struct FRpcTokenBucket
+{
+	float Tokens = 0.0f;
+	float LastRefillTime = 0.0f;
+	bool bInitialized = false;
+
+	bool TryConsume(float Now, float RefillRate, float Capacity)
+	{
+		if (!bInitialized)
+		{
+			Tokens = Capacity;
+			LastRefillTime = Now;
+			bInitialized = true;
+		}
+
+		Tokens = FMath::Min(Capacity, Tokens + FMath::Max(Now - LastRefillTime, 0.0f) * RefillRate);
+		LastRefillTime = Now;
+
+		if (Tokens < 1.0f)
+		{
+			return false;
+		}
+		Tokens -= 1.0f;
+		return true;
+	}
+};
+
+/** Client requests the server refused, by reason. */
+USTRUCT(BlueprintType)
+struct FServerValidationStats
+{
+	GENERATED_BODY()
+
+	/** Over the RPC's token bucket */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		int32 RateLimited = 0;
+
+	/** Shot origin too far from the shooter, or a batch larger than a client ever sends */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		int32 OutOfRange = 0;
+
+	/** Malformed arguments, such as a zero aim direction or another player's reload */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		int32 InvalidArgument = 0;
+
+	/** Shots fired or ammo claimed that the server's own count does not allow */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		int32 NoAmmo = 0;
+
+	int32 GetTotal() const { return RateLimited + OutOfRange + InvalidArgument + NoAmmo; }
+};
+
+/** Hit feedback shown by the owning client before the server has confirmed the shot. */
+struct FPredictedHit
+{
+	/** Sequence of the shot the hit belongs to */
+	uint16 PredictionKey = 0;
+
+	/** Impact effect spawned for the hit, removed again if the server rejects it */
+	TWeakObjectPtr<class UParticleSystemComponent> ImpactEffect;
+};
+
 UCLASS(config=Game)
 class AWSNetProdCharacter : public ACharacter
 {
 	GENERATED_BODY()
 
+	/** Load test bots drive the character through its protected input handlers */
+	friend class ULoadTestSubsystem;
+
 	/** Camera boom positioning the camera behind the character */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class USpringArmComponent* CameraBoom;
@@ -53,25 +162,48 @@ public:
 	/** Property replication */
 	void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
 
+	/** Replicates Vitals only when it has changed, see UCharacterVitalsComponent. */
+	virtual bool ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
+
+	/** Refreshes CombatState from the server's view of this character right before it replicates. */
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** Remote players aim with the rotation carried in CombatState. */
+	virtual FRotator GetBaseAimRotation() const override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Shows the crosshair once this character is ours. */
+	virtual void PawnClientRestart() override;
+
+	/**
+	 * Throttles this character's ticking and animation to Level. Set by UWSNetProdSignificanceManager for
+	 * other players' characters on clients, levels already applied are ignored.
+	 */
+	void SetSignificance(ECharacterSignificance Level);
+
+	/** World time health last changed, for significance */
+	FORCEINLINE float GetLastDamagedTime() const { return LastDamagedTime; }
+
 	/** Getter for Max Health.*/
 	UFUNCTION(BlueprintPure, Category = "Health")
 		FORCEINLINE float GetMaxHealth() const { return MaxHealth; }
 
 	/** Getter for Current Health.*/
 	UFUNCTION(BlueprintPure, Category = "Health")
-		FORCEINLINE float GetCurrentHealth() const { return CurrentHealth; }
+		float GetCurrentHealth() const;
 
-	/** Getter for Current Health.*/
+	/** Getter for Current Ammo. The owning client sees its predicted count.*/
 	UFUNCTION(BlueprintPure)
-		FORCEINLINE int GetCurrentAmmo() const { return CurrentAmmo; }
+		int GetCurrentAmmo() const;
 
 	/** Getter for reloading.*/
 	UFUNCTION(BlueprintPure)
 		FORCEINLINE bool GetReloading() const { return bReloading; }
 
-	/** Setter for reloading.*/
+	/** Setter for reloading. Clearing it tells the equipped weapon the reload has finished.*/
 	UFUNCTION(BlueprintCallable)
-		void SetReloading(bool newReloading) { bReloading = newReloading; }
+		void SetReloading(bool newReloading);
 
 	/** Setter for Current Health. Clamps the value between 0 and MaxHealth and calls OnHealthUpdate. Should only be called on the server.*/
 	UFUNCTION(BlueprintCallable, Category = "Health")
@@ -96,6 +228,26 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 		class UChildActorComponent* CurrentlyEquipped;
 
+	/** Weapons spawned once by the slots above, swapped by hiding and showing them */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		class UWeaponInventoryComponent* WeaponInventory;
+
+	/**
+	 * Makes the weapon in Slot the active one without respawning anything, see UWeaponInventoryComponent.
+	 * The owning client tells the server, remote players follow CombatState.
+	 */
+	UFUNCTION(BlueprintCallable)
+		void EquipSlot(class UChildActorComponent* Slot);
+
+	/** 1 based index of Slot for CombatState, 0 if it is not one of our weapon slots. */
+	uint8 GetSlotIndex(const class UChildActorComponent* Slot) const;
+
+	class UChildActorComponent* GetSlotByIndex(uint8 SlotIndex) const;
+
+	/** Weapon spawned by CurrentlyEquipped, cached on equip. */
+	UFUNCTION(BlueprintPure)
+		FORCEINLINE class AWeaponBase* GetEquippedWeapon() const { return EquippedWeapon; }
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 		class UBoxComponent* CBoxHead;
 
@@ -119,6 +271,26 @@ public:
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite)
 		class UBoxComponent* CBoxRightLeg;
+
+	/** Replicated health and ammo, only compared for replication after they change */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		class UCharacterVitalsComponent* Vitals;
+
+	/** Region of the body Component belongs to, None if it is not one of this character's hitboxes. */
+	UFUNCTION(BlueprintPure, Category = "Hitbox")
+		EHitRegion GetHitRegion(const UPrimitiveComponent* Component) const;
+
+	/** Server-side hitbox history used to rewind this character for lag compensated hits */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		class UHitboxHistoryComponent* HitboxHistory;
+
+	/** Poses the hitboxes from baked movement state poses on headless servers, so the anim graph does not run every frame */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		class UHitboxPoseCacheComponent* HitboxPoseCache;
+
+	/** Furthest back in time, in seconds, the server will rewind targets for a shot. */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Lag Compensation")
+		float MaxLagCompensationTime;
 	
 
 	/** Firing variable */
@@ -141,26 +313,77 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Crosshair")
 		bool bCrosshairVisable = true;
 
+	/** Creates crosshair widgets when first shown and pushes moving and firing changes to them */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crosshair")
+		class UCrosshairComponent* Crosshair;
+
 	/* Crosshair functions */
 
+	/** Prefer binding Crosshair's OnMovingChanged over polling this every frame. */
 	UFUNCTION(BlueprintCallable, Category = "Crosshair")
 		bool GetIsMoving();
 
+	/** True while the trigger is held, or for remote players while the server sees them firing. */
 	UFUNCTION(BlueprintCallable, Category = "Crosshair")
 		bool GetIsFiring();
 
+	/** Called on other players' machines when this character starts or stops firing, to drive ThirdPersonGunMesh effects. */
+	UFUNCTION(BlueprintImplementableEvent, Category = "Gameplay")
+		void ReceiveRemoteFiringChanged(bool bNowFiring);
+
 	
 
 
-	UFUNCTION(Server, Reliable)
-		void ServerApplyDamage(float someDEEPS, AActor* target);
+	/** Applies confirmed hit damage to target. Server only, never callable by clients. */
+	void ApplyHitDamage(float someDEEPS, AActor* target);
 
-	UFUNCTION(Server, Reliable)
-		void ServerLineTrace(FVector LineTraceStart, FVector LineTraceEnd, AActor* SourceGun, AActor* SourcePlayer);
+	/**
+	 * Queues a fired shot for the next batch sent to the server. Processed immediately when we are the server.
+	 * On the owning client the shot's ammo is spent on the predicted count straight away.
+	 * @return	The shot's sequence, which is the prediction key for its hit feedback
+	 */
+	uint16 QueueShot(const FVector& Start, const FVector& Direction, float ClientTime, bool bClaimedHit);
+
+	/** Shows hit feedback for a shot before the server confirms it. Rolled back if the server rejects the shot. */
+	void PredictHit(uint16 PredictionKey, const FHitResult& Hit, EHitRegion Region);
+
+	/** Sends every shot the server has not acknowledged yet. Unreliable, unacknowledged shots are resent. The server processes them on its next combat step. */
+	UFUNCTION(Server, Unreliable)
+		void ServerFireShots(const TArray<FQuantizedShot>& Shots);
+
+	/**
+	 * Tells the owning client the newest shot sequence the server has processed and how those shots went.
+	 * @param LastSequence	Newest shot sequence processed
+	 * @param ConfirmedMask	Bit i is set if shot LastSequence - i was fired and any hit it claimed was confirmed
+	 * @param Ammo			The server's ammo count after LastSequence
+	 */
+	UFUNCTION(Client, Unreliable)
+		void ClientAckShots(uint16 LastSequence, uint32 ConfirmedMask, uint16 Ammo);
+
+	/** Called on the owning client when it predicts a hit, to show a hit marker. */
+	UFUNCTION(BlueprintImplementableEvent, Category = "Gameplay")
+		void ReceivePredictedHit(int32 PredictionKey, const FHitResult& Hit, EHitRegion Region);
 
+	/** Called on the owning client when the server rejects a predicted hit, to take its hit marker back. */
+	UFUNCTION(BlueprintImplementableEvent, Category = "Gameplay")
+		void ReceivePredictedHitRejected(int32 PredictionKey);
+
+	/** Seconds to wait for an ack before resending pending shots */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Networking")
+		float ShotResendInterval;
+
+	/** Lowers the server's ammo count. The server owns ammo, so clients can never raise it this way, only a reload can. */
 	UFUNCTION(Server, Reliable, BlueprintCallable)
 		void SetCurrentAmmo(float AmmoValue);
 
+	/** Furthest a shot may start from the shooter before the server rejects it */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Networking")
+		float MaxShotOriginError;
+
+	/** Client requests rejected by the server for this character */
+	UFUNCTION(BlueprintPure, Category = "Networking")
+		FORCEINLINE FServerValidationStats GetValidationStats() const { return ValidationStats; }
+
 	
 
 	
@@ -168,6 +391,14 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+
+	virtual void PostInitializeComponents() override;
+
+	/** Stops components that only matter to a viewer from ticking. Used on dedicated servers. */
+	void StripCosmeticComponents();
+
+	/** Puts the CBox components on the Hitbox profile and keeps everything else out of weapon traces. */
+	void SetupHitboxCollision();
 	
 	/** Called for forwards/backward input */
 	void MoveForward(float Value);
@@ -197,19 +428,16 @@ protected:
 	UPROPERTY(EditDefaultsOnly, Category = "Health")
 		float MaxHealth;
 
-	/** The player's current health. When reduced to 0, they are considered dead.*/
-	UPROPERTY(Replicated, ReplicatedUsing = OnRep_CurrentHealth)
-		float CurrentHealth;
-
-	/** RepNotify for changes made to current health.*/
-	UFUNCTION()
-		void OnRep_CurrentHealth();
-
 	/** Response to health being updated. Called on the server immediately after modification, and on clients in response to a RepNotify*/
 	void OnHealthUpdate();
 
-	UPROPERTY(Replicated)
-		int CurrentAmmo;
+	float LastDamagedTime;
+
+	/** Significance level the components are currently throttled to */
+	ECharacterSignificance Significance;
+
+	/** The mesh's anim tick option before significance changed it */
+	TEnumAsByte<EVisibilityBasedAnimTickOption::Type> DefaultAnimTickOption;
 
 	/** Function for beginning weapon fire.*/
 	UFUNCTION(BlueprintCallable, Category = "Gameplay")
@@ -219,18 +447,119 @@ protected:
 	UFUNCTION(BlueprintCallable, Category = "Gameplay")
 		void StopFiring();
 
-	UFUNCTION(Server, Reliable)
-		void HandleSlotInput();
-
 	UFUNCTION(Server, Reliable)
 		void ReloadGun(AActor* ReloadTargetPlayer);
 
+	/** Switches the server's weapon to match the owning client's. */
 	UFUNCTION(Server, Reliable)
-		void DecreaseAmmo(AActor* TargetPlayer);
+		void ServerEquipSlot(uint8 SlotIndex);
+
+	/** Sent to the owning client when the server refused its switch, to put it back on the server's weapon. */
+	UFUNCTION(Client, Reliable)
+		void ClientCorrectEquippedSlot(uint8 SlotIndex);
+
+	/** Shows the weapon in Slot and makes it the one that fires, without telling anyone. */
+	void ActivateEquippedSlot(class UChildActorComponent* Slot);
+
+	/** Trigger, reload, equipped slot and aim as the server sees them. Replicated to everyone but the owner, who knows better. */
+	UPROPERTY(ReplicatedUsing = OnRep_CombatState)
+		FCombatState CombatState;
+
+	UFUNCTION()
+		void OnRep_CombatState();
+
+	/** The state OnRep_CombatState last acted on, so only changes are applied */
+	FCombatState AppliedCombatState;
+
+	/** Clears CombatState.bFiring once shots stop arriving. The server never sees the trigger itself. */
+	void ClearCombatFiring();
+
+	FTimerHandle CombatFiringTimer;
+
+	/** Decrements ammo and confirms the hit for a single shot. Server only. Returns false if the shot was refused or its claimed hit not confirmed. */
+	bool ProcessShot(const FQuantizedShot& Shot);
+
+	/** Processes the shots accepted since the last combat step, in arrival order, and acknowledges them. Server only. */
+	void ProcessStepShots(int64 Step);
+
+	/** Shots that passed validation in ServerFireShots, waiting for the next combat step. Server only. */
+	TArray<FQuantizedShot> StepShots;
+
+	/** An ack is owed to the owning client at the next combat step. */
+	bool bShotAckPending;
+
+	UPROPERTY()
+		class ACombatClock* CombatClock;
+
+	FDelegateHandle CombatStepHandle;
+
+	/** Traces a shot against the other characters' hitboxes as they were at ClientTime (server world time). Server only. Returns true on a hit. */
+	bool ConfirmHit(const FVector& Start, const FVector& End, float ClientTime);
+
+	/** Settles the predicted hits of shots up to LastSequence, rolling back those not in ConfirmedMask. Owning client only. */
+	void ResolvePredictedHits(uint16 LastSequence, uint32 ConfirmedMask);
+
+	void RollbackPredictedHit(const FPredictedHit& PredictedHit);
+
+	void FlushShots();
 
 	UPROPERTY()
 		bool bReloading;
 
+	UPROPERTY()
+		class AWeaponBase* EquippedWeapon;
+
+	/** Shots sent to the server that have not been acknowledged yet. Owning client only. */
+	TArray<FQuantizedShot> PendingShots;
+
+	uint16 NextShotSequence;
+
+	/** Newest shot sequence processed by the server. */
+	uint16 LastProcessedShotSequence;
+
+	bool bHasProcessedShot;
+
+	/** Outcome of the latest shots processed by the server, bit i for LastProcessedShotSequence - i. */
+	uint32 ConfirmedShotMask;
+
+	/** Hits shown for shots the server has not acknowledged yet. Owning client only. */
+	TArray<FPredictedHit> PredictedHits;
+
+	/** Newest shot sequence acknowledged by the server. Owning client only. */
+	uint16 LastAckedShotSequence;
+
+	bool bHasAckedShot;
+
+	/**
+	 * Ammo count shown by the owning client: the server's count from the latest ack minus the shots still in flight.
+	 * Kept apart from the replicated count so a stale update can never overwrite shots fired since.
+	 */
+	int32 PredictedAmmo;
+
+	bool bPredictingAmmo;
+
+	/** The server refills its magazine when it processes the shot that emptied ours, acks before then still count the old one. */
+	uint16 LastShotBeforeReload;
+
+	bool bAwaitingReloadAck;
+
+	FTimerHandle ShotFlushTimer;
+
+	/** Server side limits on how often the owning client may call each RPC */
+	FRpcTokenBucket ShotBucket;
+	FRpcTokenBucket ReloadBucket;
+	FRpcTokenBucket SetAmmoBucket;
+	FRpcTokenBucket EquipBucket;
+
+	UPROPERTY()
+		FServerValidationStats ValidationStats;
+
+	/** Counts a rejected client request under Reason. */
+	void RejectRequest(int32& Reason);
+
+	/** Fills the magazine of the equipped weapon. Server and owning client, never from client input on the server. */
+	void RefillAmmo();
+
 
 
 protected:
@@ -243,7 +572,5 @@ public:
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
 };
 
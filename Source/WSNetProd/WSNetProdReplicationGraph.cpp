@@ -0,0 +1,211 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WSNetProdReplicationGraph.h"
+#include "WSNetProd.h"
+#include "ReplicationGraphTypes.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "GameFramework/GameStateBase.h"
+#include "GameFramework/PlayerState.h"
+#include "UObject/UObjectIterator.h"
+#include "CharacterProjectile.h"
+#include "WSNetProdCharacter.h"
+
+UWSNetProdReplicationGraph::UWSNetProdReplicationGraph()
+{
+	GridCellSize = 10000.0f;
+	GridSpatialBias = FVector2D(-20000.0f, -20000.0f);
+}
+
+void UWSNetProdReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	// Derive each replicated class's update period and cull distance from its own defaults.
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject(false));
+		if (ActorCDO == nullptr || !ActorCDO->GetIsReplicated())
+		{
+			continue;
+		}
+
+		// Skip blueprint compiler intermediates.
+		const FString ClassName = Class->GetName();
+		if (ClassName.StartsWith(TEXT("SKEL_")) || ClassName.StartsWith(TEXT("REINST_")))
+		{
+			continue;
+		}
+
+		FClassReplicationInfo ClassInfo;
+		ClassInfo.ReplicationPeriodFrame = FMath::Max<uint32>((uint32)FMath::RoundToFloat(NetDriver->NetServerMaxTickRate / FMath::Max(ActorCDO->NetUpdateFrequency, 1.0f)), 1);
+		ClassInfo.CullDistanceSquared = ActorCDO->NetCullDistanceSquared;
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void UWSNetProdReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = GridSpatialBias;
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+
+	LowFrequencyNode = CreateNewNode<UReplicationGraphNode_ActorListFrequencyBuckets>();
+	AddGlobalGraphNode(LowFrequencyNode);
+}
+
+void UWSNetProdReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* OwnerOnlyNode = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(OwnerOnlyNode, RepGraphConnection);
+	OwnerOnlyNodes.Add(RepGraphConnection->NetConnection, OwnerOnlyNode);
+}
+
+void UWSNetProdReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+{
+	OwnerOnlyNodes.Remove(NetConnection);
+
+	// The node goes with the connection. Anything still around waits for a new owner.
+	for (auto It = OwnerOnlyActorConnections.CreateIterator(); It; ++It)
+	{
+		if (It.Value() == NetConnection)
+		{
+			ActorsWithoutNetConnection.Add(It.Key());
+			It.RemoveCurrent();
+		}
+	}
+
+	Super::RemoveClientConnection(NetConnection);
+}
+
+UReplicationGraphNode_AlwaysRelevant_ForConnection* UWSNetProdReplicationGraph::GetOwnerOnlyNodeForConnection(UNetConnection* Connection) const
+{
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* const* Node = OwnerOnlyNodes.Find(Connection);
+	return Node ? *Node : nullptr;
+}
+
+void UWSNetProdReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	AActor* Actor = ActorInfo.Actor;
+
+	if (Actor->bOnlyRelevantToOwner)
+	{
+		// Weapons and player controllers. The owning connection is often not known yet at this point.
+		ActorsWithoutNetConnection.Add(Actor);
+	}
+	else if (Actor->IsA<APlayerState>() || Actor->IsA<AGameStateBase>())
+	{
+		LowFrequencyNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+	}
+	else if (Actor->IsA<ACharacterProjectile>())
+	{
+		// Pooled projectiles spend most of their life dormant.
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+	}
+	else
+	{
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+	}
+}
+
+void UWSNetProdReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	AActor* Actor = ActorInfo.Actor;
+
+	if (Actor->bOnlyRelevantToOwner)
+	{
+		ActorsWithoutNetConnection.RemoveSwap(Actor);
+		RemoveOwnerOnlyActor(Actor);
+	}
+	else if (Actor->IsA<APlayerState>() || Actor->IsA<AGameStateBase>())
+	{
+		LowFrequencyNode->NotifyRemoveNetworkActor(ActorInfo);
+	}
+	else if (Actor->bAlwaysRelevant)
+	{
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		SetActorDestructionInfoToIgnoreDistanceCulling(Actor);
+	}
+	else if (Actor->IsA<ACharacterProjectile>())
+	{
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+	}
+	else
+	{
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+	}
+}
+
+void UWSNetProdReplicationGraph::RemoveOwnerOnlyActor(AActor* Actor)
+{
+	UNetConnection* Connection = nullptr;
+	if (!OwnerOnlyActorConnections.RemoveAndCopyValue(Actor, Connection))
+	{
+		return;
+	}
+
+	if (UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = GetOwnerOnlyNodeForConnection(Connection))
+	{
+		Node->NotifyRemoveNetworkActor(FNewReplicatedActorInfo(Actor));
+	}
+}
+
+void UWSNetProdReplicationGraph::RerouteOwnerOnlyActors()
+{
+	// Only weapons and controllers, a handful per player.
+	TArray<AActor*, TInlineAllocator<16>> Changed;
+	for (const TPair<AActor*, UNetConnection*>& Pair : OwnerOnlyActorConnections)
+	{
+		if (Pair.Key->GetNetConnection() != Pair.Value)
+		{
+			Changed.Add(Pair.Key);
+		}
+	}
+
+	for (AActor* Actor : Changed)
+	{
+		RemoveOwnerOnlyActor(Actor);
+		ActorsWithoutNetConnection.Add(Actor);
+	}
+}
+
+int32 UWSNetProdReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+	RerouteOwnerOnlyActors();
+
+	// Hand owner only actors to their connection once they have one.
+	for (int32 i = ActorsWithoutNetConnection.Num() - 1; i >= 0; i--)
+	{
+		AActor* Actor = ActorsWithoutNetConnection[i];
+		if (Actor == nullptr)
+		{
+			ActorsWithoutNetConnection.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		UNetConnection* Connection = Actor->GetNetConnection();
+		if (UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = GetOwnerOnlyNodeForConnection(Connection))
+		{
+			Node->NotifyAddNetworkActor(FNewReplicatedActorInfo(Actor));
+			OwnerOnlyActorConnections.Add(Actor, Connection);
+			ActorsWithoutNetConnection.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	const uint32 FrameRPCs = WSNetProdRpcStats::ConsumeFrameCount();
+	SET_FLOAT_STAT(STAT_WSNetProd_RPCsPerConnection, Connections.Num() > 0 ? (float)FrameRPCs / Connections.Num() : 0.0f);
+
+	return Super::ServerReplicateActors(DeltaSeconds);
+}
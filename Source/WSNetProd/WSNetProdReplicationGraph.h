@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "WSNetProdReplicationGraph.generated.h"
+
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_ActorListFrequencyBuckets;
+class UReplicationGraphNode_AlwaysRelevant_ForConnection;
+class UReplicationGraphNode_GridSpatialization2D;
+
+/**
+ * Replication graph for WSNetProd servers.
+ * Replaces the default per connection relevancy loop, which scales with connections times actors:
+ *  - Characters and projectiles live in a 2D spatial grid and are only gathered for nearby viewers.
+ *  - Weapons and other owner-only actors are only gathered for their owning connection.
+ *  - Player states and the game state are spread across frames by a low frequency node.
+ *  - Everything else marked always relevant goes to a single shared list.
+ * Enabled through ReplicationDriverClassName in DefaultEngine.ini.
+ */
+UCLASS(transient, config = Engine)
+class WSNETPROD_API UWSNetProdReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	UWSNetProdReplicationGraph();
+
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+	virtual void RemoveClientConnection(UNetConnection* NetConnection) override;
+
+	/** Size of a spatial grid cell in world units */
+	UPROPERTY(Config)
+		float GridCellSize;
+
+	/** Lower bound of the playable area, actors further out are clamped into the edge cells. Set per project in DefaultEngine.ini */
+	UPROPERTY(Config)
+		FVector2D GridSpatialBias;
+
+	UPROPERTY()
+		UReplicationGraphNode_GridSpatialization2D* GridNode;
+
+	UPROPERTY()
+		UReplicationGraphNode_ActorList* AlwaysRelevantNode;
+
+	UPROPERTY()
+		UReplicationGraphNode_ActorListFrequencyBuckets* LowFrequencyNode;
+
+private:
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* GetOwnerOnlyNodeForConnection(UNetConnection* Connection) const;
+
+	/** Owner only actors that had no connection yet when they were added, retried every frame until they do. */
+	UPROPERTY()
+		TArray<AActor*> ActorsWithoutNetConnection;
+
+	/** The connection each routed owner only actor was added under, so it is removed from there even after its owner changed. */
+	TMap<AActor*, UNetConnection*> OwnerOnlyActorConnections;
+
+	/** Takes an owner only actor out of the connection node it was added to. */
+	void RemoveOwnerOnlyActor(AActor* Actor);
+
+	/** Moves owner only actors whose owning connection changed back to ActorsWithoutNetConnection. */
+	void RerouteOwnerOnlyActors();
+
+	/** Per connection list of the owner only actors that connection owns */
+	UPROPERTY()
+		TMap<UNetConnection*, UReplicationGraphNode_AlwaysRelevant_ForConnection*> OwnerOnlyNodes;
+};
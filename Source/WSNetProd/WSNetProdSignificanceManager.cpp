@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WSNetProdSignificanceManager.h"
+#include "WSNetProd.h"
+#include "WSNetProdCharacter.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCharacterSignificance(
+	TEXT("WSNetProd.CharacterSignificance"),
+	1,
+	TEXT("1 to throttle other players' characters by significance, 0 to keep them all at full rate."),
+	ECVF_Default);
+
+const FName UWSNetProdSignificanceManager::CharacterTag(TEXT("WSNetProdCharacter"));
+
+UWSNetProdSignificanceManager::UWSNetProdSignificanceManager()
+{
+	// Servers trace against the animated hitboxes, nothing may be throttled there.
+	bCreateOnServer = false;
+	bCreateOnClient = true;
+
+	UpdateInterval = 0.1f;
+	HighSignificanceDistance = 2000.0f;
+	MediumSignificanceDistance = 5000.0f;
+	ViewConeHalfAngle = 65.0f;
+	RecentDamageTime = 3.0f;
+
+	TimeSinceUpdate = 0.0f;
+}
+
+void UWSNetProdSignificanceManager::RegisterCharacter(AWSNetProdCharacter* Character)
+{
+	RegisterObject(Character, CharacterTag,
+		[this](FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint) { return CalculateSignificance(ObjectInfo, Viewpoint); },
+		USignificanceManager::EPostSignificanceType::Sequential,
+		[this](FManagedObjectInfo* ObjectInfo, float OldSignificance, float NewSignificance, bool bFinal) { OnSignificanceUpdated(ObjectInfo, OldSignificance, NewSignificance, bFinal); });
+}
+
+void UWSNetProdSignificanceManager::UnregisterCharacter(AWSNetProdCharacter* Character)
+{
+	UnregisterObject(Character);
+}
+
+bool UWSNetProdSignificanceManager::IsTickable() const
+{
+	return !IsTemplate() && GetWorld() != nullptr;
+}
+
+TStatId UWSNetProdSignificanceManager::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UWSNetProdSignificanceManager, STATGROUP_Tickables);
+}
+
+UWorld* UWSNetProdSignificanceManager::GetTickableGameObjectWorld() const
+{
+	return GetWorld();
+}
+
+void UWSNetProdSignificanceManager::Tick(float DeltaTime)
+{
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate < UpdateInterval)
+	{
+		return;
+	}
+	TimeSinceUpdate = 0.0f;
+
+	Viewpoints.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (PlayerController != nullptr && PlayerController->IsLocalController())
+		{
+			FVector Location;
+			FRotator Rotation;
+			PlayerController->GetPlayerViewPoint(Location, Rotation);
+			Viewpoints.Add(FTransform(Rotation, Location));
+		}
+	}
+
+	// Nobody to view from, keep the last levels.
+	if (Viewpoints.Num() > 0)
+	{
+		Update(Viewpoints);
+	}
+}
+
+float UWSNetProdSignificanceManager::CalculateSignificance(FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint) const
+{
+	const AWSNetProdCharacter* Character = CastChecked<AWSNetProdCharacter>(ObjectInfo->GetObject());
+
+	if (CVarCharacterSignificance.GetValueOnGameThread() == 0 || Character->IsLocallyControlled())
+	{
+		return (float)ECharacterSignificance::High;
+	}
+
+	if (GetWorld()->GetTimeSeconds() - Character->GetLastDamagedTime() < RecentDamageTime)
+	{
+		return (float)ECharacterSignificance::High;
+	}
+
+	const FVector ToCharacter = Character->GetActorLocation() - Viewpoint.GetLocation();
+	const float DistanceSquared = ToCharacter.SizeSquared();
+	const bool bInView = FVector::DotProduct(ToCharacter.GetSafeNormal(), Viewpoint.GetRotation().GetForwardVector()) >= FMath::Cos(FMath::DegreesToRadians(ViewConeHalfAngle));
+
+	if (DistanceSquared < FMath::Square(HighSignificanceDistance))
+	{
+		return (float)(bInView ? ECharacterSignificance::High : ECharacterSignificance::Low);
+	}
+	if (DistanceSquared < FMath::Square(MediumSignificanceDistance))
+	{
+		return (float)(bInView ? ECharacterSignificance::Medium : ECharacterSignificance::Low);
+	}
+	return (float)(bInView ? ECharacterSignificance::Low : ECharacterSignificance::Culled);
+}
+
+void UWSNetProdSignificanceManager::OnSignificanceUpdated(FManagedObjectInfo* ObjectInfo, float OldSignificance, float NewSignificance, bool bFinal)
+{
+	AWSNetProdCharacter* Character = CastChecked<AWSNetProdCharacter>(ObjectInfo->GetObject());
+
+	// Unregistered characters are put back to full rate. The character ignores levels it already has.
+	Character->SetSignificance(bFinal ? ECharacterSignificance::High : (ECharacterSignificance)FMath::RoundToInt(NewSignificance));
+}
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SignificanceManager.h"
+#include "Tickable.h"
+#include "WSNetProdSignificanceManager.generated.h"
+
+class AWSNetProdCharacter;
+
+/** How much of a remote character's animation and ticking a client keeps up, least first. */
+enum class ECharacterSignificance : uint8
+{
+	/** Out of view and far away: mesh and movement tick slowly, gun mesh not at all */
+	Culled,
+	/** Far, or out of view but close enough to turn to */
+	Low,
+	/** In view at mid range */
+	Medium,
+	/** Close and in view, recently damaged, or our own */
+	High
+};
+
+/**
+ * Scores other players' characters on clients by distance and view direction from the local players' viewpoints,
+ * and raises any that were damaged recently. Each character then throttles its own components to match, see
+ * AWSNetProdCharacter::SetSignificance. Servers keep everything at full rate, lag compensation needs the real poses.
+ * Updated at UpdateInterval instead of every frame.
+ */
+UCLASS(config = Engine)
+class WSNETPROD_API UWSNetProdSignificanceManager : public USignificanceManager, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UWSNetProdSignificanceManager();
+
+	/** Tag characters are registered under */
+	static const FName CharacterTag;
+
+	void RegisterCharacter(AWSNetProdCharacter* Character);
+	void UnregisterCharacter(AWSNetProdCharacter* Character);
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override;
+	// End of FTickableGameObject interface
+
+	/** Seconds between significance updates */
+	UPROPERTY(config)
+		float UpdateInterval;
+
+	/** In view and closer than this is High */
+	UPROPERTY(config)
+		float HighSignificanceDistance;
+
+	/** In view and closer than this is Medium, out of view and closer than this is Low */
+	UPROPERTY(config)
+		float MediumSignificanceDistance;
+
+	/** Half angle of the cone in front of a viewpoint that counts as in view, wider than the camera so turning is covered */
+	UPROPERTY(config)
+		float ViewConeHalfAngle;
+
+	/** Characters damaged less than this many seconds ago are High wherever they are */
+	UPROPERTY(config)
+		float RecentDamageTime;
+
+private:
+	float CalculateSignificance(FManagedObjectInfo* ObjectInfo, const FTransform& Viewpoint) const;
+
+	void OnSignificanceUpdated(FManagedObjectInfo* ObjectInfo, float OldSignificance, float NewSignificance, bool bFinal);
+
+	/** Local player viewpoints, reused every update */
+	TArray<FTransform> Viewpoints;
+
+	float TimeSinceUpdate;
+};
@@ -8,46 +8,202 @@
 #include "Engine/Classes/Engine/World.h"
 #include "Engine/World.h"
 #include "CollisionQueryParams.h"
+#include "GameFramework/GameStateBase.h"
 #include "WeaponBase.h"
+#include "WSNetProd.h"
+#include "CombatClock.h"
+#include "HeadlessProfile.h"
+#include "WeaponDefinitionRegistry.h"
+#include "WeaponInventoryComponent.h"
+#include "Net/UnrealNetwork.h"
 
 
 // Sets default values
 AWeaponBase::AWeaponBase()
 {
- 	// Set this pawn to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Firing and reloading are driven by input events, timers and combat steps, so the weapon never ticks.
+	PrimaryActorTick.bCanEverTick = false;
 
 	SceneRoot = CreateDefaultSubobject<USceneComponent>(TEXT("SceneRoot"));
 	SceneRoot->SetupAttachment(RootComponent);
 
 	GunMesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("GunMesh"));
 	GunMesh->SetupAttachment(SceneRoot);
+	GunMesh->SetCollisionResponseToChannel(ECC_Hitbox, ECR_Ignore);
 
 	BarrelParticleEmitterLocation = CreateDefaultSubobject<USceneComponent>(TEXT("BarrelParticleEmitterLocation"));
 	BarrelParticleEmitterLocation->SetupAttachment(GunMesh);
 
-	bCanFireGun = true;
-	
+	// Only the owning player needs the gun actor, everyone else sees the third person mesh.
+	bOnlyRelevantToOwner = true;
+
+	WeaponState = EWeaponState::Idle;
+
+	RegionDamageMultipliers.Add(EHitRegion::Head, 2.0f);
+	RegionDamageMultipliers.Add(EHitRegion::Torso, 1.0f);
+	RegionDamageMultipliers.Add(EHitRegion::Arm, 0.75f);
+	RegionDamageMultipliers.Add(EHitRegion::Leg, 0.75f);
 }
 
 // Called when the game starts or when spawned
 void AWeaponBase::BeginPlay()
 {
 	Super::BeginPlay();
-	PlayerCharacter = Cast<AWSNetProdCharacter>(UGameplayStatics::GetPlayerCharacter(GetWorld(), 0));
-	
+	PlayerCharacter = Cast<AWSNetProdCharacter>(GetParentActor());
+	CombatClock = ACombatClock::Get(this);
+
+	// On the owning client the slot's weapon replicates in after the character set up its inventory.
+	if (PlayerCharacter != nullptr && PlayerCharacter->WeaponInventory != nullptr)
+	{
+		PlayerCharacter->WeaponInventory->RegisterSlotWeapon(this, GetParentComponent());
+	}
+
+	if (WSNetProdHeadless::IsHeadless(this))
+	{
+		WSNetProdHeadless::StripCosmeticComponent(GunMesh);
+	}
 }
 
-// Called every frame
-void AWeaponBase::Tick(float DeltaTime)
+void AWeaponBase::PostInitializeComponents()
 {
-	Super::Tick(DeltaTime);
-	CurrentAmmo = Cast<AWSNetProdCharacter>(PlayerCharacter)->GetCurrentAmmo();
+	Super::PostInitializeComponents();
 
-	if (CurrentAmmo <= 0)
+	RefreshDefinition();
+
+	if (UWeaponDefinitionRegistry* Registry = UWeaponDefinitionRegistry::Get())
+	{
+		DefinitionsReloadedHandle = Registry->OnDefinitionsReloaded.AddUObject(this, &AWeaponBase::RefreshDefinition);
+	}
+}
+
+void AWeaponBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SetSteppingWithClock(false);
+
+	if (UWeaponDefinitionRegistry* Registry = UWeaponDefinitionRegistry::Get())
+	{
+		Registry->OnDefinitionsReloaded.Remove(DefinitionsReloadedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AWeaponBase::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(AWeaponBase, WeaponId);
+	DOREPLIFETIME(AWeaponBase, DefinitionHash);
+}
+
+namespace
+{
+	FWeaponReplicatedStats MakeReplicatedStats(const FWeaponDefinition& Definition)
+	{
+		FWeaponReplicatedStats Stats;
+		Stats.FireRate = Definition.FireRate;
+		Stats.MagazineSize = Definition.MagazineSize;
+		Stats.BulletDistance = Definition.BulletDistance;
+		Stats.bFiresSimulatedProjectiles = Definition.bFiresSimulatedProjectiles;
+		return Stats;
+	}
+
+	/** Never 0, which stands for no hash yet. */
+	uint32 HashReplicatedStats(const FWeaponReplicatedStats& Stats)
+	{
+		uint32 Hash = GetTypeHash(Stats.FireRate);
+		Hash = HashCombine(Hash, GetTypeHash(Stats.MagazineSize));
+		Hash = HashCombine(Hash, GetTypeHash(Stats.BulletDistance));
+		Hash = HashCombine(Hash, GetTypeHash((uint8)Stats.bFiresSimulatedProjectiles));
+		return Hash != 0 ? Hash : 1;
+	}
+}
+
+void AWeaponBase::RefreshDefinition()
+{
+	if (UWeaponDefinitionRegistry* Registry = UWeaponDefinitionRegistry::Get())
+	{
+		Definition = Registry->FindDefinition(WeaponId, this);
+	}
+	else
+	{
+		Definition = MakeShared<FWeaponDefinition>(MakeClassDefaultDefinition());
+	}
+
+	if (Role == ROLE_Authority)
 	{
-		PlayerCharacter->ReloadGun_Implementation(PlayerCharacter);
+		DefinitionHash = HashReplicatedStats(MakeReplicatedStats(*Definition));
+		return;
 	}
+
+	if (DefinitionHash == 0 || HashReplicatedStats(MakeReplicatedStats(*Definition)) == DefinitionHash)
+	{
+		return;
+	}
+
+	if (ServerStatsHash == DefinitionHash)
+	{
+		// The local definition is stale or missing, keep a private copy with the server's values.
+		TSharedRef<FWeaponDefinition> ServerDefinition = MakeShared<FWeaponDefinition>(*Definition);
+		ServerDefinition->FireRate = ServerStats.FireRate;
+		ServerDefinition->MagazineSize = ServerStats.MagazineSize;
+		ServerDefinition->BulletDistance = ServerStats.BulletDistance;
+		ServerDefinition->bFiresSimulatedProjectiles = ServerStats.bFiresSimulatedProjectiles;
+		Definition = ServerDefinition;
+	}
+	else if (RequestedStatsHash != DefinitionHash && GetNetConnection() != nullptr)
+	{
+		// Only the owning client has this weapon, and so a connection to ask on.
+		RequestedStatsHash = DefinitionHash;
+		ServerRequestDefinitionStats();
+	}
+}
+
+void AWeaponBase::SetWeaponId(uint8 NewWeaponId)
+{
+	if (Role == ROLE_Authority && NewWeaponId != WeaponId)
+	{
+		WeaponId = NewWeaponId;
+		RefreshDefinition();
+	}
+}
+
+void AWeaponBase::OnRep_WeaponId()
+{
+	RefreshDefinition();
+}
+
+void AWeaponBase::OnRep_DefinitionHash()
+{
+	RefreshDefinition();
+}
+
+void AWeaponBase::ServerRequestDefinitionStats_Implementation()
+{
+	WSNetProdRpcStats::Count(TEXT("ServerRequestDefinitionStats"));
+
+	ClientReceiveDefinitionStats(MakeReplicatedStats(GetDefinition()));
+}
+
+void AWeaponBase::ClientReceiveDefinitionStats_Implementation(const FWeaponReplicatedStats& Stats)
+{
+	ServerStats = Stats;
+	ServerStatsHash = HashReplicatedStats(Stats);
+	RefreshDefinition();
+}
+
+FWeaponDefinition AWeaponBase::MakeClassDefaultDefinition() const
+{
+	FWeaponDefinition ClassDefinition;
+	ClassDefinition.Damage = Damage;
+	ClassDefinition.FireRate = FireRate;
+	ClassDefinition.MagazineSize = MagazineSize;
+	ClassDefinition.TotalAmmo = TotalAmmo;
+	ClassDefinition.RecoilStrength = RecoilStrength;
+	ClassDefinition.BulletDistance = BulletDistance;
+	ClassDefinition.bFiresSimulatedProjectiles = bFiresSimulatedProjectiles;
+	ClassDefinition.RegionDamageMultipliers = RegionDamageMultipliers;
+	return ClassDefinition;
 }
 
 // Called to bind functionality to input
@@ -59,61 +215,193 @@ void AWeaponBase::SetupPlayerInputComponent(UInputComponent* PlayerInputComponen
 
 void AWeaponBase::HandleInput()
 {
-	if (bCanFireGun)
+	if (CanFireNow() && WeaponState != EWeaponState::Reloading && WeaponState != EWeaponState::Switching)
 	{
-		bCanFireGun = false;
-		UWorld* World = GetWorld();
-		World->GetTimerManager().SetTimer(FiringTimer, this, &AWeaponBase::StopFire, FireRate, false);
-		FireBullet();
+		FireShot();
+	}
+}
+
+void AWeaponBase::StartFire()
+{
+	if (WeaponState != EWeaponState::Idle)
+	{
+		return;
+	}
+
+	WeaponState = EWeaponState::Firing;
+	SetSteppingWithClock(true);
+	if (CanFireNow())
+	{
+		FireShot();
 	}
 }
 
 void AWeaponBase::StopFire()
 {
-	bCanFireGun = true;
+	if (WeaponState == EWeaponState::Firing)
+	{
+		WeaponState = EWeaponState::Idle;
+		SetSteppingWithClock(false);
+	}
+}
+
+void AWeaponBase::Equip(AWSNetProdCharacter* NewOwner)
+{
+	PlayerCharacter = NewOwner;
+	WeaponState = EWeaponState::Idle;
+	CurrentAmmo = PlayerCharacter->GetCurrentAmmo();
+}
+
+void AWeaponBase::Unequip()
+{
+	WeaponState = EWeaponState::Switching;
+	SetSteppingWithClock(false);
+}
+
+void AWeaponBase::FireShot()
+{
+	// The cooldown is a whole number of steps, so the cadence is the same at any frame rate.
+	if (CombatClock != nullptr)
+	{
+		NextFireStep = CombatClock->GetStep() + CombatClock->SecondsToSteps(GetFireRate());
+	}
+	FireBullet();
+
+	CurrentAmmo = PlayerCharacter->GetCurrentAmmo();
+	if (CurrentAmmo <= 0)
+	{
+		BeginReload();
+	}
+}
+
+void AWeaponBase::OnCombatStep(int64 Step)
+{
+	if (WeaponState != EWeaponState::Firing)
+	{
+		SetSteppingWithClock(false);
+		return;
+	}
+
+	if (Step >= NextFireStep)
+	{
+		FireShot();
+	}
+}
+
+void AWeaponBase::SetSteppingWithClock(bool bStepping)
+{
+	if (CombatClock == nullptr || bStepping == CombatStepHandle.IsValid())
+	{
+		return;
+	}
+
+	if (bStepping)
+	{
+		CombatStepHandle = CombatClock->OnCombatStep.AddUObject(this, &AWeaponBase::OnCombatStep);
+	}
+	else
+	{
+		CombatClock->OnCombatStep.Remove(CombatStepHandle);
+		CombatStepHandle.Reset();
+	}
+}
+
+bool AWeaponBase::CanFireNow() const
+{
+	return CombatClock == nullptr || CombatClock->GetStep() >= NextFireStep;
+}
+
+void AWeaponBase::BeginReload()
+{
+	WeaponState = EWeaponState::Reloading;
+	SetSteppingWithClock(false);
+	PlayerCharacter->ReloadGun_Implementation(PlayerCharacter);
+}
+
+void AWeaponBase::OnReloadFinished()
+{
+	if (WeaponState != EWeaponState::Reloading)
+	{
+		return;
+	}
+
+	CurrentAmmo = PlayerCharacter->GetCurrentAmmo();
+	WeaponState = EWeaponState::Idle;
+
+	// Carry on firing if the trigger was held through the reload.
+	if (PlayerCharacter->GetIsFiring())
+	{
+		StartFire();
+	}
+}
+
+float AWeaponBase::GetDamageForRegion(EHitRegion Region) const
+{
+	const FWeaponDefinition& Stats = GetDefinition();
+	const float* Multiplier = Stats.RegionDamageMultipliers.Find(Region);
+	return Stats.Damage * (Multiplier ? *Multiplier : 1.0f);
+}
+
+bool AWeaponBase::TraceShot(const FVector& Start, const FVector& End, const AActor* Shooter, FWeaponTraceResult& OutResult) const
+{
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(WeaponTrace));
+	Params.AddIgnoredActor(this);
+	Params.AddIgnoredActor(Shooter);
+
+	INC_DWORD_STAT(STAT_WSNetProd_Traces);
+
+	OutResult = FWeaponTraceResult();
+	if (!GetWorld()->LineTraceSingleByChannel(OutResult.Hit, Start, End, ECC_Hitbox, Params))
+	{
+		return false;
+	}
+
+	UPrimitiveComponent* HitComponent = OutResult.Hit.GetComponent();
+	AWSNetProdCharacter* HitCharacter = HitComponent ? Cast<AWSNetProdCharacter>(HitComponent->GetOwner()) : nullptr;
+	if (HitCharacter == nullptr)
+	{
+		return false;
+	}
+
+	OutResult.Region = HitCharacter->GetHitRegion(HitComponent);
+	if (OutResult.Region == EHitRegion::None)
+	{
+		return false;
+	}
+
+	OutResult.Character = HitCharacter;
+	return true;
 }
 
 void AWeaponBase::FireBullet()
 {
-	TArray<FHitResult> MultiHit;
-	FHitResult SingleHit;
+	SCOPE_CYCLE_COUNTER(STAT_WSNetProd_FireBullet);
+
 	FVector BulletStart = PlayerCharacter->GetFollowCamera()->GetComponentLocation();
-	FVector BulletEnd = PlayerCharacter->GetFollowCamera()->GetComponentLocation() + (PlayerCharacter->GetFollowCamera()->GetForwardVector() * BulletDistance);
-	FCollisionObjectQueryParams Objects;
-	FCollisionQueryParams Params;
-	
-	Params.AddIgnoredActor(this);
-	Params.AddIgnoredActor(PlayerCharacter);
-	
-	bool BulletTrace = GetWorld()->LineTraceSingleByObjectType(SingleHit, BulletStart, BulletEnd, Objects, Params);
-	
-
-	DrawDebugLine(GetWorld(), PlayerCharacter->GetFollowCamera()->GetComponentLocation(), (PlayerCharacter->GetFollowCamera()->GetComponentLocation() + (PlayerCharacter->GetFollowCamera()->GetForwardVector() * BulletDistance)), FColor::Green, false, 10, 0, 5);
-
-	if (BulletTrace && IsValid(Cast<AWSNetProdCharacter>(SingleHit.Actor))) // Has the trace hit anything & Is the actor a player?
-	{
-		Params.AddIgnoredComponent(Cast<AWSNetProdCharacter>(SingleHit.Actor)->GetCapsuleComponent()); // Ignore the player capsule component so we can hit the hitboxs 
-		bool SecondBulletTrace = GetWorld()->LineTraceSingleByChannel(SingleHit, BulletStart, BulletEnd, ECC_Visibility, Params);
-		
-		if (SecondBulletTrace && IsValid(Cast<AWSNetProdCharacter>(SingleHit.GetComponent()->GetAttachmentRootActor()))) // has the trace hit anything & if there is a component, is it attached to the player?
-		{
-			// successfully hit a player character with a local cast
-			UE_LOG(LogTemp, Warning, TEXT("Client hit: %s"), *SingleHit.GetActor()->GetName());
-
-			// tell the server to shoot a trace to apply damage
-			this->PlayerCharacter->ServerLineTrace(BulletStart, BulletEnd, this, PlayerCharacter);
-
-			/*
-			FVector NormalImpulse;
-			FHitResult Hit;
-			
-			AWSNetProdCharacter* actor = Cast<AWSNetProdCharacter>(SingleHit.Actor.Get());
-			this->PlayerCharacter->ServerApplyDamage(1.0f, SingleHit.Actor.Get());
-			*/
-			
-		}
-	}
-	
-	// decrease ammo count
-	this->PlayerCharacter->DecreaseAmmo_Implementation(PlayerCharacter);
+	FVector BulletEnd = PlayerCharacter->GetFollowCamera()->GetComponentLocation() + (PlayerCharacter->GetFollowCamera()->GetForwardVector() * GetBulletDistance());
+	AGameStateBase* GameState = GetWorld()->GetGameState();
+	const float ShotTime = GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+
+	if (FiresSimulatedProjectiles())
+	{
+		// The server simulates the projectile and replicates its flight, there is nothing to trace here.
+		this->PlayerCharacter->QueueShot(BulletStart, PlayerCharacter->GetFollowCamera()->GetForwardVector(), ShotTime, false);
+		return;
+	}
+
+	FWeaponTraceResult TraceResult;
+	const bool bClientHit = TraceShot(BulletStart, BulletEnd, PlayerCharacter, TraceResult);
+
+#if WITH_WSNETPROD_COSMETICS && ENABLE_DRAW_DEBUG
+	DrawDebugLine(GetWorld(), BulletStart, BulletEnd, FColor::Green, false, 10, 0, 5);
+#endif
+
+	// send the shot to the server, which decreases ammo and confirms the hit rewound to the time we fired at
+	const uint16 PredictionKey = this->PlayerCharacter->QueueShot(BulletStart, PlayerCharacter->GetFollowCamera()->GetForwardVector(), ShotTime, bClientHit);
+
+	if (bClientHit)
+	{
+		UE_LOG(LogWSNetProdShots, Verbose, TEXT("Client hit: %s (%s)"), *TraceResult.Character->GetName(), *StaticEnum<EHitRegion>()->GetNameStringByValue((int64)TraceResult.Region));
+		PlayerCharacter->PredictHit(PredictionKey, TraceResult.Hit, TraceResult.Region);
+	}
 }
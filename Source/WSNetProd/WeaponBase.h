@@ -5,8 +5,59 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Pawn.h"
 #include "WSNetProdCharacter.h"
+#include "WeaponDefinition.h"
 #include "WeaponBase.generated.h"
 
+/** What the weapon is currently doing. Transitions are driven by input events and timers, never by ticking. */
+UENUM(BlueprintType)
+enum class EWeaponState : uint8
+{
+	Idle,
+	Firing,
+	Reloading,
+	Switching
+};
+
+/** Outcome of a weapon trace. */
+USTRUCT(BlueprintType)
+struct FWeaponTraceResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+		FHitResult Hit;
+
+	/** Character owning the hitbox that was hit, null if the trace hit the world or nothing */
+	UPROPERTY(BlueprintReadOnly)
+		AWSNetProdCharacter* Character = nullptr;
+
+	UPROPERTY(BlueprintReadOnly)
+		EHitRegion Region = EHitRegion::None;
+};
+
+/**
+ * The definition stats the owning client predicts with. Only the server's hash of them replicates; a client
+ * whose local definition hashes differently asks for the server's values, so a definitions reload there
+ * reaches clients whatever tables and files they have locally.
+ */
+USTRUCT()
+struct FWeaponReplicatedStats
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		float FireRate = 0.0f;
+
+	UPROPERTY()
+		int32 MagazineSize = 0;
+
+	UPROPERTY()
+		float BulletDistance = 0.0f;
+
+	UPROPERTY()
+		bool bFiresSimulatedProjectiles = false;
+};
+
 UCLASS()
 class WSNETPROD_API AWeaponBase : public APawn
 {
@@ -30,11 +81,70 @@ public:
 	UFUNCTION(BlueprintCallable)
 		void HandleInput();
 
+	/** Trigger pressed. Fires immediately if the cooldown allows and keeps firing every FireRate seconds, counted in combat steps. */
+	UFUNCTION(BlueprintCallable)
+		void StartFire();
+
+	/** Trigger released. */
+	UFUNCTION(BlueprintCallable)
+		void StopFire();
+
+	/** Called by the owning character when this weapon becomes the active one. */
+	void Equip(AWSNetProdCharacter* NewOwner);
+
+	/** Called by the owning character when switching away from this weapon. */
+	void Unequip();
+
+	/** Called by the owning character once its reload has finished. */
+	void OnReloadFinished();
+
+	UFUNCTION(BlueprintPure)
+		FORCEINLINE EWeaponState GetWeaponState() const { return WeaponState; }
+
+	/** Stats this weapon fires with, shared with every other weapon using the same definition. */
+	FORCEINLINE const FWeaponDefinition& GetDefinition() const { check(Definition.IsValid()); return *Definition; }
+
+	UFUNCTION()
+		FORCEINLINE int GetMagazineSize() const { return GetDefinition().MagazineSize; }
+
+	UFUNCTION()
+		FORCEINLINE int GetDamage() const { return GetDefinition().Damage; }
+
+	UFUNCTION()
+		FORCEINLINE float GetBulletDistance() const { return GetDefinition().BulletDistance; }
+
 	UFUNCTION()
-		FORCEINLINE int GetMagazineSize() const { return MagazineSize; }
+		FORCEINLINE float GetFireRate() const { return GetDefinition().FireRate; }
+
+	UFUNCTION(BlueprintPure)
+		FORCEINLINE uint8 GetWeaponId() const { return WeaponId; }
+
+	/** Switches this weapon to another definition. Server only, the id replicates. */
+	UFUNCTION(BlueprintCallable)
+		void SetWeaponId(uint8 NewWeaponId);
+
+	/** Builds a definition from this class's own stat properties, for weapons without a table entry. */
+	FWeaponDefinition MakeClassDefaultDefinition() const;
+
+	/** Base damage scaled by the multiplier for Region. */
+	UFUNCTION(BlueprintPure)
+		float GetDamageForRegion(EHitRegion Region) const;
+
+	/**
+	 * Traces a shot on the Hitbox channel, ignoring this weapon and Shooter. One trace resolves both
+	 * whether a character was hit and where: capsules and meshes ignore the channel, hitboxes and the world block it.
+	 * @return true if a character's hitbox was hit.
+	 */
+	bool TraceShot(const FVector& Start, const FVector& End, const AActor* Shooter, FWeaponTraceResult& OutResult) const;
 
 	UFUNCTION()
-		FORCEINLINE int GetDamage() const { return Damage; }
+		FORCEINLINE bool FiresSimulatedProjectiles() const { return GetDefinition().bFiresSimulatedProjectiles; }
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	/** Spawned where a shot hits a character, as soon as the owning client predicts the hit */
+	UPROPERTY(EditDefaultsOnly, Category = "Effects")
+		class UParticleSystem* HitImpactEffect = nullptr;
 
 
 
@@ -42,6 +152,56 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void PostInitializeComponents() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Looks the definition up again, after the id changed or the registry reloaded.
+	 * The server publishes the hash of its predicted stats in DefinitionHash. Clients whose definition does not
+	 * match it lay the server's stats over theirs, asking for them first if they have not got them yet.
+	 */
+	void RefreshDefinition();
+
+	UFUNCTION()
+		void OnRep_WeaponId();
+
+	UFUNCTION()
+		void OnRep_DefinitionHash();
+
+	/** Asks for the server's predicted stats, sent when the owning client's definition does not match DefinitionHash. */
+	UFUNCTION(Server, Reliable)
+		void ServerRequestDefinitionStats();
+
+	UFUNCTION(Client, Reliable)
+		void ClientReceiveDefinitionStats(const FWeaponReplicatedStats& Stats);
+
+	/** Hash of the server's values of the stats clients predict with, 0 until it has arrived */
+	UPROPERTY(ReplicatedUsing = OnRep_DefinitionHash)
+		uint32 DefinitionHash = 0;
+
+	/** The server's predicted stats, received on request. Client only */
+	FWeaponReplicatedStats ServerStats;
+
+	/** DefinitionHash ServerStats belong to, 0 if none were received */
+	uint32 ServerStatsHash = 0;
+
+	/** DefinitionHash the server's stats were last asked for, so each change is only asked for once */
+	uint32 RequestedStatsHash = 0;
+
+	/** Definition in UWeaponDefinitionRegistry. 0 uses the definition bound to this class, or the stats below */
+	UPROPERTY(EditDefaultsOnly, ReplicatedUsing = OnRep_WeaponId, Category = "Gun stats")
+		uint8 WeaponId = 0;
+
+	TSharedPtr<const FWeaponDefinition> Definition;
+
+	FDelegateHandle DefinitionsReloadedHandle;
+
+	/*
+	 * Class default stats, only read when the registry has no definition for this weapon.
+	 * Live values come from GetDefinition().
+	 */
+
 	/** Damage */
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Gun stats")
 		float Damage = 1.0f;
@@ -50,7 +210,8 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Gun stats")
 		float FireRate = 0.25f;
 
-	FTimerHandle FiringTimer;
+	/** First combat step the cooldown allows another shot in */
+	int64 NextFireStep = 0;
 
 	/** Magazine size */
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Gun stats")
@@ -60,6 +221,10 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Gun stats")
 		int TotalAmmo = 90;
 
+	/** Damage multiplier per body region. Regions not listed take base damage */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Gun stats")
+		TMap<EHitRegion, float> RegionDamageMultipliers;
+
 	/** Recoil strength */
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Gun stats")
 		float RecoilStrength = 1.0f;
@@ -71,13 +236,34 @@ protected:
 	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Category = "Gun stats")
 		int CurrentAmmo;
 
-	UFUNCTION(BlueprintCallable)
-		void StopFire();
+	/** Fire travelling projectiles through AProjectileSimulation instead of instant hit traces */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Gun stats")
+		bool bFiresSimulatedProjectiles = false;
 
 	UFUNCTION(BlueprintCallable)
 		void FireBullet();
 
-	bool bCanFireGun = true;
+	/** Fires one shot, starts the cooldown and begins a reload if the magazine ran dry. */
+	void FireShot();
+
+	/** Fires again once the cooldown is over, for as long as the trigger is held. */
+	void OnCombatStep(int64 Step);
+
+	/** Steps with the combat clock while firing, the weapon has nothing to do otherwise. */
+	void SetSteppingWithClock(bool bStepping);
+
+	/** Whether the cooldown allows a shot now. */
+	bool CanFireNow() const;
+
+	UPROPERTY()
+		class ACombatClock* CombatClock;
+
+	FDelegateHandle CombatStepHandle;
+
+	void BeginReload();
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+		EWeaponState WeaponState;
 
 	AWSNetProdCharacter* PlayerCharacter;
 
@@ -85,9 +271,6 @@ protected:
 
 
 public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 	// Called to bind functionality to input
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataTable.h"
+#include "WSNetProdCharacter.h"
+#include "WeaponDefinition.generated.h"
+
+class AWeaponBase;
+
+/**
+ * Balance stats for one weapon. Loaded once by UWeaponDefinitionRegistry and shared read-only by every
+ * weapon using it. Weapons refer to a definition by WeaponId and replicate only that id and a hash of the stats clients predict with.
+ */
+USTRUCT(BlueprintType)
+struct FWeaponDefinition : public FTableRowBase
+{
+	GENERATED_BODY()
+
+	/** Small id weapons reference this definition by. 0 is reserved for "use the weapon class defaults" */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Weapon")
+		uint8 WeaponId = 0;
+
+	/** Weapon class that picks up this definition when it has no id of its own */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Weapon")
+		TSoftClassPtr<AWeaponBase> WeaponClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		float Damage = 1.0f;
+
+	/** Seconds between shots */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		float FireRate = 0.25f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		int32 MagazineSize = 30;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		int32 TotalAmmo = 90;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		float RecoilStrength = 1.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		float BulletDistance = 5000.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		bool bFiresSimulatedProjectiles = false;
+
+	/** Damage multiplier per body region. Regions not listed take base damage */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Gun stats")
+		TMap<EHitRegion, float> RegionDamageMultipliers;
+};
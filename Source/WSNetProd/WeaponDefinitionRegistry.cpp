@@ -0,0 +1,176 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponDefinitionRegistry.h"
+#include "WSNetProd.h"
+#include "WeaponBase.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/Csv/CsvParser.h"
+
+UWeaponDefinitionRegistry* UWeaponDefinitionRegistry::Get()
+{
+	return GEngine ? GEngine->GetEngineSubsystem<UWeaponDefinitionRegistry>() : nullptr;
+}
+
+void UWeaponDefinitionRegistry::EnsureLoaded()
+{
+	if (!bLoaded)
+	{
+		Reload();
+	}
+}
+
+TSharedRef<const FWeaponDefinition> UWeaponDefinitionRegistry::FindDefinition(uint8 Id, const AWeaponBase* Weapon)
+{
+	EnsureLoaded();
+
+	if (Id == 0)
+	{
+		Id = FindIdForClass(Weapon->GetClass());
+	}
+
+	if (const TSharedRef<const FWeaponDefinition>* Definition = Definitions.Find(Id))
+	{
+		return *Definition;
+	}
+
+	const UClass* WeaponClass = Weapon->GetClass();
+	if (const TSharedRef<const FWeaponDefinition>* Definition = ClassDefaultDefinitions.Find(WeaponClass))
+	{
+		return *Definition;
+	}
+
+	TSharedRef<const FWeaponDefinition> Definition = MakeShared<FWeaponDefinition>(WeaponClass->GetDefaultObject<AWeaponBase>()->MakeClassDefaultDefinition());
+	ClassDefaultDefinitions.Add(WeaponClass, Definition);
+	return Definition;
+}
+
+uint8 UWeaponDefinitionRegistry::FindIdForClass(const UClass* WeaponClass)
+{
+	EnsureLoaded();
+
+	// Only a handful of weapons exist, a linear search beats keeping a second map in sync.
+	for (const TPair<uint8, TSharedRef<const FWeaponDefinition>>& Pair : Definitions)
+	{
+		if (Pair.Value->WeaponClass.ToSoftObjectPath() == FSoftObjectPath(WeaponClass))
+		{
+			return Pair.Key;
+		}
+	}
+	return 0;
+}
+
+void UWeaponDefinitionRegistry::AddDefinition(const FWeaponDefinition& Definition)
+{
+	if (Definition.WeaponId == 0)
+	{
+		UE_LOG(LogWSNetProd, Warning, TEXT("Weapon definition with id 0 ignored, 0 is reserved for class defaults."));
+		return;
+	}
+
+	Definitions.Add(Definition.WeaponId, MakeShared<FWeaponDefinition>(Definition));
+}
+
+void UWeaponDefinitionRegistry::Reload(const FString& File)
+{
+	bLoaded = true;
+	Definitions.Reset();
+	ClassDefaultDefinitions.Reset();
+
+	if (DefinitionsTable.IsValid())
+	{
+		if (UDataTable* Table = Cast<UDataTable>(DefinitionsTable.TryLoad()))
+		{
+			TArray<FWeaponDefinition*> Rows;
+			Table->GetAllRows<FWeaponDefinition>(TEXT("WeaponDefinitionRegistry"), Rows);
+			for (const FWeaponDefinition* Row : Rows)
+			{
+				AddDefinition(*Row);
+			}
+		}
+		else
+		{
+			UE_LOG(LogWSNetProd, Warning, TEXT("Weapon definitions table %s could not be loaded."), *DefinitionsTable.ToString());
+		}
+	}
+
+	const FString CSVFile = File.IsEmpty() ? DefinitionsFile : File;
+	if (!CSVFile.IsEmpty())
+	{
+		const FString Path = FPaths::IsRelative(CSVFile) ? FPaths::Combine(FPaths::ProjectConfigDir(), CSVFile) : CSVFile;
+		if (FPaths::FileExists(Path))
+		{
+			LoadFromCSV(Path);
+		}
+	}
+
+	UE_LOG(LogWSNetProd, Log, TEXT("Loaded %d weapon definitions."), Definitions.Num());
+	OnDefinitionsReloaded.Broadcast();
+}
+
+int32 UWeaponDefinitionRegistry::LoadFromCSV(const FString& Path)
+{
+	FString Contents;
+	if (!FFileHelper::LoadFileToString(Contents, *Path))
+	{
+		UE_LOG(LogWSNetProd, Warning, TEXT("Could not read weapon definitions from %s."), *Path);
+		return 0;
+	}
+
+	// Same layout as a data table CSV export: a header of property names, the first column is the row name.
+	const FCsvParser Parser(Contents);
+	const FCsvParser::FRows& Rows = Parser.GetRows();
+	if (Rows.Num() < 2)
+	{
+		return 0;
+	}
+
+	const TArray<const TCHAR*>& Header = Rows[0];
+	TArray<UProperty*> Columns;
+	Columns.Add(nullptr);
+	for (int32 Column = 1; Column < Header.Num(); Column++)
+	{
+		UProperty* Property = FindField<UProperty>(FWeaponDefinition::StaticStruct(), Header[Column]);
+		if (Property == nullptr)
+		{
+			UE_LOG(LogWSNetProd, Warning, TEXT("%s: unknown weapon definition column '%s' ignored."), *Path, Header[Column]);
+		}
+		Columns.Add(Property);
+	}
+
+	int32 NumRead = 0;
+	for (int32 RowIndex = 1; RowIndex < Rows.Num(); RowIndex++)
+	{
+		const TArray<const TCHAR*>& Row = Rows[RowIndex];
+		FWeaponDefinition Definition;
+		for (int32 Column = 1; Column < Row.Num() && Column < Columns.Num(); Column++)
+		{
+			if (Columns[Column] != nullptr && Columns[Column]->ImportText(Row[Column], Columns[Column]->ContainerPtrToValuePtr<void>(&Definition), PPF_None, nullptr) == nullptr)
+			{
+				UE_LOG(LogWSNetProd, Warning, TEXT("%s: row '%s' has a bad value for %s."), *Path, Row[0], *Columns[Column]->GetName());
+			}
+		}
+		AddDefinition(Definition);
+		NumRead++;
+	}
+	return NumRead;
+}
+
+namespace
+{
+	void ReloadWeaponDefinitions(const TArray<FString>& Args, UWorld* World)
+	{
+		if (UWeaponDefinitionRegistry* Registry = UWeaponDefinitionRegistry::Get())
+		{
+			Registry->Reload(Args.Num() > 0 ? Args[0] : FString());
+		}
+	}
+
+	FAutoConsoleCommandWithWorldAndArgs ReloadWeaponDefinitionsCommand(
+		TEXT("WSNetProd.ReloadWeaponDefinitions"),
+		TEXT("Reloads weapon definitions and applies them to live weapons. Run it on the server, clients take the server's stats. Optionally takes a CSV file to read instead of the configured one."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ReloadWeaponDefinitions));
+}
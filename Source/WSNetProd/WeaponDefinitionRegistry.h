@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "WeaponDefinition.h"
+#include "WeaponDefinitionRegistry.generated.h"
+
+class AWeaponBase;
+
+/**
+ * Process wide table of weapon definitions, indexed by WeaponId.
+ * Definitions come from the DefinitionsTable data table, then rows from DefinitionsFile (CSV, same layout as a
+ * data table export) are laid over it. Both can be reloaded on a live server with WSNetProd.ReloadWeaponDefinitions;
+ * weapons pick the new stats up through OnDefinitionsReloaded without respawning, and owners whose own definitions
+ * differ fetch the stats they predict with from the server.
+ */
+UCLASS(config = Game)
+class WSNETPROD_API UWeaponDefinitionRegistry : public UEngineSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	static UWeaponDefinitionRegistry* Get();
+
+	/**
+	 * Returns the definition for Id, falling back to a definition bound to Weapon's class and then to one built
+	 * from the class defaults. Never null.
+	 */
+	TSharedRef<const FWeaponDefinition> FindDefinition(uint8 Id, const AWeaponBase* Weapon);
+
+	/** Id of the definition bound to WeaponClass, or 0 if there is none. */
+	uint8 FindIdForClass(const UClass* WeaponClass);
+
+	/** Rebuilds every definition from the table and CSV file. File overrides DefinitionsFile when set. */
+	void Reload(const FString& File = FString());
+
+	/** Broadcast after Reload(). Weapons holding a definition should look it up again. */
+	FSimpleMulticastDelegate OnDefinitionsReloaded;
+
+	/** Data table of FWeaponDefinition rows */
+	UPROPERTY(Config)
+		FSoftObjectPath DefinitionsTable;
+
+	/** CSV of FWeaponDefinition rows, relative to the project config directory */
+	UPROPERTY(Config)
+		FString DefinitionsFile;
+
+private:
+	void EnsureLoaded();
+
+	void AddDefinition(const FWeaponDefinition& Definition);
+
+	/** Parses rows from a CSV file into Definitions. Returns the number of rows read. */
+	int32 LoadFromCSV(const FString& Path);
+
+	TMap<uint8, TSharedRef<const FWeaponDefinition>> Definitions;
+
+	/** Definitions built from weapon class defaults, for weapons without a table entry */
+	TMap<TWeakObjectPtr<const UClass>, TSharedRef<const FWeaponDefinition>> ClassDefaultDefinitions;
+
+	bool bLoaded = false;
+};
@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "WeaponInventoryComponent.h"
+#include "WSNetProd.h"
+#include "WeaponBase.h"
+#include "WSNetProdCharacter.h"
+#include "Components/ChildActorComponent.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/World.h"
+
+UWeaponInventoryComponent::UWeaponInventoryComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+
+	ActiveSlot = 0;
+	bWeaponsVisible = true;
+}
+
+void UWeaponInventoryComponent::InitializeSlots(const TArray<UChildActorComponent*>& Slots)
+{
+	Weapons.Reset(Slots.Num());
+	SlotParents.Reset(Slots.Num());
+	for (UChildActorComponent* Slot : Slots)
+	{
+		Weapons.Add(Slot ? Cast<AWeaponBase>(Slot->GetChildActor()) : nullptr);
+		SlotParents.Add(Slot);
+	}
+
+	// Enough room to swap every slot out once without growing.
+	SpareWeapons.Reserve(Slots.Num() + SpareWeaponClasses.Num());
+
+	for (AWeaponBase* Weapon : Weapons)
+	{
+		if (Weapon != nullptr)
+		{
+			SetWeaponActive(Weapon, false);
+		}
+	}
+}
+
+void UWeaponInventoryComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	for (TSubclassOf<AWeaponBase> WeaponClass : SpareWeaponClasses)
+	{
+		if (AWeaponBase* Weapon = SpawnWeapon(WeaponClass))
+		{
+			SpareWeapons.Add(Weapon);
+		}
+	}
+}
+
+void UWeaponInventoryComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Slot child actors go with their components, the rest are ours.
+	for (AWeaponBase* Weapon : SpawnedWeapons)
+	{
+		if (Weapon != nullptr && !Weapon->IsPendingKill())
+		{
+			Weapon->Destroy();
+		}
+	}
+	SpawnedWeapons.Reset();
+	SpareWeapons.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+AWeaponBase* UWeaponInventoryComponent::GetWeapon(uint8 SlotIndex) const
+{
+	return SlotIndex > 0 && Weapons.IsValidIndex(SlotIndex - 1) ? Weapons[SlotIndex - 1] : nullptr;
+}
+
+AWeaponBase* UWeaponInventoryComponent::ActivateSlot(uint8 SlotIndex)
+{
+	AWeaponBase* OldWeapon = GetActiveWeapon();
+	AWeaponBase* NewWeapon = GetWeapon(SlotIndex);
+
+	if (OldWeapon != nullptr && OldWeapon != NewWeapon)
+	{
+		SetWeaponActive(OldWeapon, false);
+	}
+
+	ActiveSlot = GetSlotParent(SlotIndex) != nullptr ? SlotIndex : 0;
+
+	if (NewWeapon != nullptr)
+	{
+		SetWeaponActive(NewWeapon, true);
+	}
+	return NewWeapon;
+}
+
+void UWeaponInventoryComponent::RegisterSlotWeapon(AWeaponBase* Weapon, USceneComponent* SlotComponent)
+{
+	const int32 Index = SlotComponent != nullptr ? SlotParents.Find(SlotComponent) : INDEX_NONE;
+	if (Index == INDEX_NONE || Weapons[Index] == Weapon)
+	{
+		// Not initialized yet, InitializeSlots takes the weapon from its slot then.
+		return;
+	}
+
+	if (Weapons[Index] != nullptr)
+	{
+		// The slot was given another weapon in the meantime.
+		ShowWeapon(Weapon, false);
+		return;
+	}
+
+	Weapons[Index] = Weapon;
+
+	const uint8 SlotIndex = (uint8)(Index + 1);
+	if (SlotIndex != ActiveSlot)
+	{
+		SetWeaponActive(Weapon, false);
+		return;
+	}
+
+	// Through the character, which caches its active weapon. The slot is already equipped there, so nothing is sent.
+	AWSNetProdCharacter* Character = GetCharacter();
+	if (Character != nullptr)
+	{
+		Character->EquipSlot(Character->GetSlotByIndex(SlotIndex));
+	}
+	else
+	{
+		SetWeaponActive(Weapon, true);
+	}
+}
+
+bool UWeaponInventoryComponent::SetSlotWeapon(uint8 SlotIndex, TSubclassOf<AWeaponBase> WeaponClass)
+{
+	if (SlotIndex == 0 || !Weapons.IsValidIndex(SlotIndex - 1) || WeaponClass == nullptr)
+	{
+		return false;
+	}
+
+	AWeaponBase* OldWeapon = Weapons[SlotIndex - 1];
+	if (OldWeapon != nullptr && OldWeapon->GetClass() == WeaponClass)
+	{
+		return true;
+	}
+
+	AWeaponBase* NewWeapon = nullptr;
+	for (int32 i = 0; i < SpareWeapons.Num(); i++)
+	{
+		if (SpareWeapons[i]->GetClass() == WeaponClass)
+		{
+			NewWeapon = SpareWeapons[i];
+			SpareWeapons.RemoveAtSwap(i, 1, false);
+			break;
+		}
+	}
+
+	if (NewWeapon == nullptr)
+	{
+		UE_LOG(LogWSNetProd, Verbose, TEXT("%s: spawning %s, no spare to reuse"), *GetOwner()->GetName(), *WeaponClass->GetName());
+		NewWeapon = SpawnWeapon(WeaponClass);
+		if (NewWeapon == nullptr)
+		{
+			return false;
+		}
+	}
+
+	const bool bWasActive = SlotIndex == ActiveSlot;
+	if (OldWeapon != nullptr)
+	{
+		if (bWasActive)
+		{
+			SetWeaponActive(OldWeapon, false);
+		}
+		SpareWeapons.Add(OldWeapon);
+	}
+
+	NewWeapon->AttachToComponent(SlotParents[SlotIndex - 1], FAttachmentTransformRules::SnapToTargetNotIncludingScale);
+	Weapons[SlotIndex - 1] = NewWeapon;
+
+	if (bWasActive)
+	{
+		// Through the character, which caches its active weapon.
+		AWSNetProdCharacter* Character = GetCharacter();
+		if (Character != nullptr)
+		{
+			Character->EquipSlot(Character->GetSlotByIndex(SlotIndex));
+		}
+		else
+		{
+			SetWeaponActive(NewWeapon, true);
+		}
+	}
+	return true;
+}
+
+void UWeaponInventoryComponent::SetWeaponsVisible(bool bVisible)
+{
+	bWeaponsVisible = bVisible;
+
+	if (AWeaponBase* ActiveWeapon = GetActiveWeapon())
+	{
+		ShowWeapon(ActiveWeapon, bWeaponsVisible);
+	}
+}
+
+void UWeaponInventoryComponent::ShowWeapon(AWeaponBase* Weapon, bool bShow)
+{
+	// Hidden guns are not posed either. Stripped meshes cannot tick at all, so this never wakes one up.
+	Weapon->SetActorHiddenInGame(!bShow);
+	Weapon->GunMesh->SetComponentTickEnabled(bShow);
+}
+
+void UWeaponInventoryComponent::SetWeaponActive(AWeaponBase* Weapon, bool bActive)
+{
+	ShowWeapon(Weapon, bActive && bWeaponsVisible);
+
+	if (bActive)
+	{
+		if (AWSNetProdCharacter* Character = GetCharacter())
+		{
+			Weapon->Equip(Character);
+		}
+	}
+	else
+	{
+		Weapon->StopFire();
+		Weapon->Unequip();
+	}
+}
+
+AWeaponBase* UWeaponInventoryComponent::SpawnWeapon(TSubclassOf<AWeaponBase> WeaponClass)
+{
+	if (WeaponClass == nullptr)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters Params;
+	Params.Owner = GetOwner();
+	Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	AWeaponBase* Weapon = GetWorld()->SpawnActor<AWeaponBase>(WeaponClass, GetOwner()->GetActorTransform(), Params);
+	if (Weapon == nullptr)
+	{
+		return nullptr;
+	}
+
+	SetWeaponActive(Weapon, false);
+	SpawnedWeapons.Add(Weapon);
+	return Weapon;
+}
+
+USceneComponent* UWeaponInventoryComponent::GetSlotParent(uint8 SlotIndex) const
+{
+	return SlotIndex > 0 && SlotParents.IsValidIndex(SlotIndex - 1) ? SlotParents[SlotIndex - 1] : nullptr;
+}
+
+AWSNetProdCharacter* UWeaponInventoryComponent::GetCharacter() const
+{
+	return Cast<AWSNetProdCharacter>(GetOwner());
+}
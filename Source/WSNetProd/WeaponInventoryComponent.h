@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WeaponInventoryComponent.generated.h"
+
+class AWeaponBase;
+class AWSNetProdCharacter;
+class UChildActorComponent;
+
+/**
+ * A character's weapons, spawned once and kept for the character's lifetime.
+ * Swapping weapons only hides the old instance and shows the new one, so no weapon actor is ever destroyed
+ * or respawned and the active weapon keeps its timers. Replacing the weapon in a slot takes a spare instance of
+ * the class if there is one, so after warm-up slot changes do not spawn or allocate either.
+ * Not replicated: the active slot index travels in the character's FCombatState.
+ */
+UCLASS(ClassGroup = (Custom))
+class WSNETPROD_API UWeaponInventoryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UWeaponInventoryComponent();
+
+	/**
+	 * Takes the weapons spawned by Slots as the inventory, slot index i + 1 being Slots[i].
+	 * Weapons later put in a slot attach to that slot's component. Must be called before BeginPlay.
+	 * Change weapons with SetSlotWeapon from then on, changing a slot's child actor class would respawn it.
+	 */
+	void InitializeSlots(const TArray<UChildActorComponent*>& Slots);
+
+	/**
+	 * Makes the weapon in SlotIndex the active one and hides the rest.
+	 * A slot whose weapon has not replicated yet stays active and is equipped once the weapon registers.
+	 * @param SlotIndex		1 based slot, 0 for no weapon
+	 * @return				The newly active weapon, null if the slot is empty
+	 */
+	AWeaponBase* ActivateSlot(uint8 SlotIndex);
+
+	/**
+	 * Takes a slot's weapon that was not spawned when the slots were initialized. Replicated slot weapons are only
+	 * spawned by the server, so on the owning client they call this from BeginPlay once they arrive.
+	 * @param SlotComponent	The child actor component that spawned Weapon on the server
+	 */
+	void RegisterSlotWeapon(AWeaponBase* Weapon, USceneComponent* SlotComponent);
+
+	/**
+	 * Puts a weapon of WeaponClass in SlotIndex on this machine. The weapon it replaces is kept as a spare.
+	 * Spawns only if there is no spare of the class, see SpareWeaponClasses.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Weapons")
+		bool SetSlotWeapon(uint8 SlotIndex, TSubclassOf<AWeaponBase> WeaponClass);
+
+	/** Whether weapons are shown at all. False for other players' first person guns and on servers. */
+	void SetWeaponsVisible(bool bVisible);
+
+	UFUNCTION(BlueprintPure, Category = "Weapons")
+		AWeaponBase* GetWeapon(uint8 SlotIndex) const;
+
+	UFUNCTION(BlueprintPure, Category = "Weapons")
+		FORCEINLINE AWeaponBase* GetActiveWeapon() const { return GetWeapon(ActiveSlot); }
+
+	UFUNCTION(BlueprintPure, Category = "Weapons")
+		FORCEINLINE uint8 GetActiveSlot() const { return ActiveSlot; }
+
+	FORCEINLINE int32 GetNumSlots() const { return Weapons.Num(); }
+
+	/** Weapon classes spawned as hidden spares when play begins, so putting them in a slot later does not spawn */
+	UPROPERTY(EditDefaultsOnly, Category = "Weapons")
+		TArray<TSubclassOf<AWeaponBase>> SpareWeaponClasses;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void ShowWeapon(AWeaponBase* Weapon, bool bShow);
+
+	/** Shows and equips, or hides and unequips, a weapon. */
+	void SetWeaponActive(AWeaponBase* Weapon, bool bActive);
+
+	AWeaponBase* SpawnWeapon(TSubclassOf<AWeaponBase> WeaponClass);
+
+	USceneComponent* GetSlotParent(uint8 SlotIndex) const;
+
+	AWSNetProdCharacter* GetCharacter() const;
+
+	/** Weapon per slot, slot index 1 at element 0 */
+	UPROPERTY()
+		TArray<AWeaponBase*> Weapons;
+
+	/** Component each slot's weapon is attached to */
+	UPROPERTY()
+		TArray<USceneComponent*> SlotParents;
+
+	/** Hidden weapons not in any slot, waiting to be reused */
+	UPROPERTY()
+		TArray<AWeaponBase*> SpareWeapons;
+
+	/** Weapons spawned by this component rather than by a slot's child actor component, destroyed with it */
+	UPROPERTY()
+		TArray<AWeaponBase*> SpawnedWeapons;
+
+	/** Slot last activated, even if its weapon has not arrived yet */
+	uint8 ActiveSlot;
+
+	bool bWeaponsVisible;
+};